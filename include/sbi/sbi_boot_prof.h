@@ -0,0 +1,84 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * Copyright (c) 2026 agent
+ *
+ * Authors:
+ *   agent <agent@local>
+ *
+ * Boot phase profiling based on the mcycle counter.
+ */
+
+#ifndef __SBI_BOOT_PROF_H__
+#define __SBI_BOOT_PROF_H__
+
+#include <sbi/sbi_types.h>
+
+struct sbi_scratch;
+
+/** Boot phases in the order they run in init_coldboot() */
+enum sbi_boot_phase {
+	SBI_BOOT_PHASE_SCRATCH = 0,
+	SBI_BOOT_PHASE_DOMAIN,
+	SBI_BOOT_PHASE_HSM,
+	SBI_BOOT_PHASE_PLATFORM_EARLY,
+	SBI_BOOT_PHASE_HART,
+	SBI_BOOT_PHASE_CONSOLE,
+	SBI_BOOT_PHASE_PMU,
+	SBI_BOOT_PHASE_ILLEGAL_INSN,
+	SBI_BOOT_PHASE_BANNER,
+	SBI_BOOT_PHASE_IRQCHIP,
+	SBI_BOOT_PHASE_IPI,
+	SBI_BOOT_PHASE_TLB,
+	SBI_BOOT_PHASE_TIMER,
+	SBI_BOOT_PHASE_ECALL,
+	SBI_BOOT_PHASE_HEXT,
+	SBI_BOOT_PHASE_DOMAIN_FINALIZE,
+	SBI_BOOT_PHASE_PMP,
+	SBI_BOOT_PHASE_PLATFORM_FINAL,
+	SBI_BOOT_PHASE_MAX
+};
+
+/** Cycles spent in each boot phase of one HART */
+struct sbi_boot_prof {
+	u64 last;
+	u64 cycles[SBI_BOOT_PHASE_MAX];
+};
+
+#ifdef CONFIG_SBI_BOOT_PROFILE
+
+/** Start profiling, must be called before the first phase begins */
+void sbi_boot_prof_start(struct sbi_boot_prof *prof);
+
+/** Account cycles since the previous mark to the given phase */
+void sbi_boot_prof_mark(struct sbi_boot_prof *prof, enum sbi_boot_phase phase);
+
+/** Print the cold boot profile as part of the boot prints */
+void sbi_boot_prof_print(struct sbi_scratch *scratch,
+			 const struct sbi_boot_prof *prof);
+
+/** Print a warm boot profile when debug prints are enabled */
+void sbi_boot_prof_dprint(u32 hartid, const struct sbi_boot_prof *prof);
+
+/** Add the cold boot profile to /chosen of the next stage FDT */
+int sbi_boot_prof_fdt_export(struct sbi_scratch *scratch,
+			     const struct sbi_boot_prof *prof);
+
+#else
+
+static inline void sbi_boot_prof_start(struct sbi_boot_prof *prof) { }
+static inline void sbi_boot_prof_mark(struct sbi_boot_prof *prof,
+				      enum sbi_boot_phase phase) { }
+static inline void sbi_boot_prof_print(struct sbi_scratch *scratch,
+				       const struct sbi_boot_prof *prof) { }
+static inline void sbi_boot_prof_dprint(u32 hartid,
+					const struct sbi_boot_prof *prof) { }
+static inline int sbi_boot_prof_fdt_export(struct sbi_scratch *scratch,
+					   const struct sbi_boot_prof *prof)
+{
+	return 0;
+}
+
+#endif
+
+#endif
@@ -19,6 +19,13 @@ struct sbi_console_device {
 	/** Write a character to the console output */
 	void (*console_putc)(char ch);
 
+	/**
+	 * Write a character string to the console output (optional)
+	 * Returns the number of characters written, which may be less
+	 * than len. Line ends are not translated.
+	 */
+	int (*console_puts)(const char *str, int len);
+
 	/** Read a character from the console input */
 	int (*console_getc)(void);
 };
@@ -33,8 +40,12 @@ void sbi_putc(char ch);
 
 void sbi_puts(const char *str);
 
+unsigned long sbi_nputs(const char *str, unsigned long len);
+
 void sbi_gets(char *s, int maxwidth, char endchar);
 
+unsigned long sbi_ngets(char *str, unsigned long len);
+
 int __printf(2, 3) sbi_sprintf(char *out, const char *format, ...);
 
 int __printf(3, 4) sbi_snprintf(char *out, u32 out_sz, const char *format, ...);
@@ -53,6 +64,22 @@ struct sbi_scratch;
 
 int sbi_console_init(struct sbi_scratch *scratch);
 
+#ifdef CONFIG_SBI_CONSOLE_RING
+
+/** Write out some buffered output unless another HART is doing so */
+void sbi_console_drain(void);
+
+/** Write out all buffered output of all HARTs */
+void sbi_console_flush(void);
+
+#else
+
+static inline void sbi_console_drain(void) { }
+
+static inline void sbi_console_flush(void) { }
+
+#endif
+
 #define SBI_ASSERT(cond, args) do { \
 	if (unlikely(!(cond))) \
 		sbi_panic args; \
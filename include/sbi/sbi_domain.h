@@ -88,6 +88,14 @@ struct sbi_domain_memregion {
 	unsigned long flags;
 };
 
+/** Address range of a domain resolving to its first matching region */
+struct sbi_domain_memrange {
+	/** Start address, the range ends where the next range starts */
+	unsigned long start;
+	/** Memory region covering the range or NULL if there is none */
+	const struct sbi_domain_memregion *reg;
+};
+
 /** Maximum number of domains */
 #define SBI_DOMAIN_MAX_INDEX			32
 
@@ -110,6 +118,14 @@ struct sbi_domain {
 	const struct sbi_hartmask *possible_harts;
 	/** Array of memory regions terminated by a region with order zero */
 	struct sbi_domain_memregion *regions;
+	/**
+	 * Non-overlapping address ranges sorted by start address which
+	 * index the memory regions
+	 * Note: This set by sbi_domain_finalize() in the coldboot path
+	 */
+	const struct sbi_domain_memrange *ranges;
+	/** Number of entries in ranges */
+	u32 range_count;
 	/** HART id of the HART booting this domain */
 	u32 boot_hartid;
 	/** Arg1 (or 'a1' register) of next booting stage for this domain */
@@ -196,6 +212,39 @@ bool sbi_domain_check_addr(const struct sbi_domain *dom,
 			   unsigned long addr, unsigned long mode,
 			   unsigned long access_flags);
 
+/**
+ * Check whether we can access the specified address range for given
+ * mode and memory region flags under a domain
+ * @param dom pointer to domain
+ * @param addr the start of the address range to be checked
+ * @param size the size of the address range to be checked
+ * @param mode the privilege mode of access
+ * @param access_flags bitmask of domain access types (enum sbi_domain_access)
+ * @return true if access allowed otherwise false
+ */
+bool sbi_domain_check_addr_range(const struct sbi_domain *dom,
+				 unsigned long addr, unsigned long size,
+				 unsigned long mode,
+				 unsigned long access_flags);
+
+/**
+ * Check whether S-mode of the current HART's domain can access a shared
+ * memory buffer passed to an SBI call
+ *
+ * The buffer is accessed with physical addresses from M-mode so the
+ * upper XLEN bits of its address have to be zero on both RV32 and RV64.
+ * Callers report a failed check as SBI_EINVALID_ADDR, unless their
+ * extension specifies another error.
+ *
+ * @param addr_lo lower XLEN bits of the buffer physical address
+ * @param addr_hi upper XLEN bits of the buffer physical address
+ * @param size the size of the buffer
+ * @param access_flags bitmask of domain access types (enum sbi_domain_access)
+ * @return true if access allowed otherwise false
+ */
+bool sbi_domain_check_shmem(unsigned long addr_lo, unsigned long addr_hi,
+			    unsigned long size, unsigned long access_flags);
+
 /** Dump domain details on the console */
 void sbi_domain_dump(const struct sbi_domain *dom, const char *suffix);
 
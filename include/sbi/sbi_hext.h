@@ -24,6 +24,12 @@ struct pt_area_info {
 	unsigned long free_list;
 };
 
+/**
+ * Per-HART H extension emulation state
+ *
+ * Updated on almost every trap, so each entry of hart_hext_state[] is
+ * cache line aligned to keep HARTs from writing to a shared line.
+ */
 struct hext_state {
 	struct pt_area_info pt_area;
 
@@ -93,7 +99,7 @@ struct hext_state {
 
 	bool virt;
 	bool available;
-};
+} __cacheline_aligned;
 
 extern unsigned long hext_mstatus_features;
 extern struct hext_state hart_hext_state[];
@@ -102,15 +108,26 @@ extern unsigned long hext_pt_size;
 
 int sbi_hext_init(struct sbi_scratch *scratch, bool cold_boot);
 
-int sbi_hext_csr_read(int csr_num, struct sbi_trap_regs *regs,
-		      unsigned long *csr_val);
-int sbi_hext_csr_write(int csr_num, struct sbi_trap_regs *regs,
-		       unsigned long csr_val);
+/*
+ * Emulated hypervisor CSR accesses. The caller has already checked that
+ * emulation is enabled, that the access comes from HS-mode (or is a satp
+ * access from VS-mode) and passes the current HART's state.
+ */
+int sbi_hext_csr_read(struct hext_state *hext, int csr_num,
+		      struct sbi_trap_regs *regs, unsigned long *csr_val);
+int sbi_hext_csr_write(struct hext_state *hext, int csr_num,
+		       struct sbi_trap_regs *regs, unsigned long csr_val);
 int sbi_hext_insn(unsigned long insn, struct sbi_trap_regs *regs);
 
 void sbi_hext_switch_virt(struct sbi_trap_regs *regs, struct hext_state *hext,
 			  bool virt);
 
+/*
+ * Re-apply the M-mode controls derived from the emulated state of the
+ * current HART after a non-retentive suspend.
+ */
+void sbi_hext_resume(void);
+
 inline bool sbi_hext_enabled()
 {
 	return hext_pt_start != 0;
@@ -118,9 +135,7 @@ inline bool sbi_hext_enabled()
 
 inline struct hext_state *sbi_hext_current_state()
 {
-	const struct sbi_platform *platform = sbi_platform_thishart_ptr();
-	u32 index = sbi_platform_hart_index(platform, current_hartid());
-	return &hart_hext_state[index];
+	return &hart_hext_state[current_hartindex()];
 }
 
 int sbi_hext_pt_init(unsigned long pt_start, unsigned long nodes_per_hart);
@@ -12,8 +12,14 @@
 
 #include <sbi/sbi_types.h>
 
+struct sbi_scratch;
 struct sbi_trap_regs;
 
 int sbi_illegal_insn_handler(ulong insn, struct sbi_trap_regs *regs);
 
+/** Forget cached illegal instructions of the current HART */
+void sbi_illegal_insn_cache_flush(void);
+
+int sbi_illegal_insn_init(struct sbi_scratch *scratch, bool cold_boot);
+
 #endif
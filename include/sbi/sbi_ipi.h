@@ -11,11 +11,15 @@
 #define __SBI_IPI_H__
 
 #include <sbi/sbi_types.h>
+#include <sbi/sbi_hartmask.h>
 
 /* clang-format off */
 
 #define SBI_IPI_EVENT_MAX			__riscv_xlen
 
+#define SBI_IPI_CLUSTER_NONE			-1U
+#define SBI_IPI_CLUSTER_MAX			32
+
 /* clang-format on */
 
 /** IPI hardware device */
@@ -26,6 +30,13 @@ struct sbi_ipi_device {
 	/** Send IPI to a target HART */
 	void (*ipi_send)(u32 target_hart);
 
+	/**
+	 * Send IPI to all HARTs in a hartmask
+	 * Note: This is an optional callback. If not provided, the IPI is
+	 * sent to each target HART using ipi_send().
+	 */
+	void (*ipi_send_mask)(const struct sbi_hartmask *target_mask);
+
 	/** Clear IPI for a target HART */
 	void (*ipi_clear)(u32 target_hart);
 };
@@ -49,7 +60,9 @@ struct sbi_ipi_event_ops {
 	/**
 	 * Sync callback to wait for remote HART
 	 * Note: This is an optional callback and it is called just after
-	 * triggering IPI to remote HART.
+	 * triggering IPI to remote HART. While waiting it must call
+	 * sbi_ipi_process_forward() because the remote HART may only get
+	 * its IPI through current HART.
 	 */
 	void (* sync)(struct sbi_scratch *scratch);
 
@@ -77,6 +90,10 @@ void sbi_ipi_process(void);
 
 int sbi_ipi_raw_send(u32 target_hart);
 
+int sbi_ipi_set_hart_cluster(u32 hartid, u32 cluster);
+
+void sbi_ipi_process_forward(void);
+
 const struct sbi_ipi_device *sbi_ipi_get_device(void);
 
 void sbi_ipi_set_device(const struct sbi_ipi_device *dev);
@@ -124,6 +124,16 @@ int sbi_pmu_ctr_start(unsigned long cidx_base, unsigned long cidx_mask,
 
 int sbi_pmu_ctr_get_info(uint32_t cidx, unsigned long *ctr_info);
 
+/**
+ * Set or clear the counter snapshot shared memory of current HART.
+ * @param shmem_lo Lower XLEN bits of the physical address
+ * @param shmem_hi Upper XLEN bits of the physical address
+ * @param flags    Reserved, must be zero
+ * @return 0 on success, error otherwise.
+ */
+int sbi_pmu_snapshot_set_shmem(unsigned long shmem_lo,
+			       unsigned long shmem_hi, unsigned long flags);
+
 unsigned long sbi_pmu_num_ctr(void);
 
 int sbi_pmu_ctr_cfg_match(unsigned long cidx_base, unsigned long cidx_mask,
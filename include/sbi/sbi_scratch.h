@@ -38,10 +38,17 @@
 #define SBI_SCRATCH_TMP0_OFFSET			(10 * __SIZEOF_POINTER__)
 /** Offset of options member in sbi_scratch */
 #define SBI_SCRATCH_OPTIONS_OFFSET		(11 * __SIZEOF_POINTER__)
+/** Offset of hartindex member in sbi_scratch */
+#define SBI_SCRATCH_HARTINDEX_OFFSET		(12 * __SIZEOF_POINTER__)
 /** Offset of extra space in sbi_scratch */
-#define SBI_SCRATCH_EXTRA_SPACE_OFFSET		(12 * __SIZEOF_POINTER__)
+#define SBI_SCRATCH_EXTRA_SPACE_OFFSET		(13 * __SIZEOF_POINTER__)
 /** Maximum size of sbi_scratch (4KB) */
 #define SBI_SCRATCH_SIZE			(0x1000)
+/** Size of extra space in sbi_scratch */
+#define SBI_SCRATCH_EXTRA_SPACE_SIZE		\
+	(SBI_SCRATCH_SIZE - SBI_SCRATCH_EXTRA_SPACE_OFFSET)
+/** Maximum number of allocations from extra space in sbi_scratch */
+#define SBI_SCRATCH_ALLOC_MAX			32
 
 /* clang-format on */
 
@@ -75,6 +82,8 @@ struct sbi_scratch {
 	unsigned long tmp0;
 	/** Options for OpenSBI library */
 	unsigned long options;
+	/** Index of the HART in the platform HART table */
+	unsigned long hartindex;
 };
 
 /**
@@ -136,6 +145,11 @@ _Static_assert(
 		== SBI_SCRATCH_OPTIONS_OFFSET,
 	"struct sbi_scratch definition has changed, please redefine "
 	"SBI_SCRATCH_OPTIONS_OFFSET");
+_Static_assert(
+	offsetof(struct sbi_scratch, hartindex)
+		== SBI_SCRATCH_HARTINDEX_OFFSET,
+	"struct sbi_scratch definition has changed, please redefine "
+	"SBI_SCRATCH_HARTINDEX_OFFSET");
 
 /** Possible options for OpenSBI library */
 enum sbi_scratch_options {
@@ -149,6 +163,10 @@ enum sbi_scratch_options {
 #define sbi_scratch_thishart_ptr() \
 	((struct sbi_scratch *)csr_read(CSR_MSCRATCH))
 
+/** Get index of current HART in the platform HART table */
+#define current_hartindex() \
+	(sbi_scratch_thishart_ptr()->hartindex)
+
 /** Get Arg1 of next booting stage for current HART */
 #define sbi_scratch_thishart_arg1_ptr() \
 	((void *)(sbi_scratch_thishart_ptr()->next_arg1))
@@ -156,6 +174,24 @@ enum sbi_scratch_options {
 /** Initialize scratch table and allocator */
 int sbi_scratch_init(struct sbi_scratch *scratch);
 
+/**
+ * Allocate aligned extra space in sbi_scratch
+ *
+ * Data written by remote HARTs (queues, locks, pending bits) should use
+ * SBI_CACHE_LINE_SIZE alignment so that it does not share a cache line
+ * with data only touched by the owning HART.
+ *
+ * @param owner name of the allocating subsystem shown by sbi_scratch_dump()
+ * @param size number of bytes to allocate
+ * @param align power-of-2 alignment of the allocation
+ *
+ * @return zero on failure and non-zero (>= SBI_SCRATCH_EXTRA_SPACE_OFFSET)
+ * on success
+ */
+unsigned long sbi_scratch_alloc_aligned_offset(const char *owner,
+					       unsigned long size,
+					       unsigned long align);
+
 /**
  * Allocate from extra space in sbi_scratch
  *
@@ -164,9 +200,19 @@ int sbi_scratch_init(struct sbi_scratch *scratch);
  */
 unsigned long sbi_scratch_alloc_offset(unsigned long size);
 
-/** Free-up extra space in sbi_scratch */
+/**
+ * Free-up extra space in sbi_scratch
+ *
+ * Only the most recent allocation is actually released.
+ */
 void sbi_scratch_free_offset(unsigned long offset);
 
+/** Get number of bytes allocated from extra space in sbi_scratch */
+unsigned long sbi_scratch_used_space(void);
+
+/** Print the extra space allocations of sbi_scratch */
+void sbi_scratch_dump(const char *suffix);
+
 /** Get pointer from offset in sbi_scratch */
 #define sbi_scratch_offset_ptr(scratch, offset)	(void *)((char *)(scratch) + (offset))
 
@@ -30,6 +30,27 @@ struct sbi_timer_device {
 	void (*timer_event_stop)(void);
 };
 
+/**
+ * Timer event queued on the per-HART event queue
+ *
+ * An event must be zero initialized before it is added for the first
+ * time and it may only be queued on the HART which owns it. The handler
+ * runs in M-mode trap context of that HART once the deadline expires.
+ */
+struct sbi_timer_event {
+	/** Absolute deadline in timer ticks */
+	u64 deadline;
+
+	/** Called on the owning HART after the deadline expires */
+	void (*handler)(struct sbi_timer_event *ev);
+
+	/** Position in the event queue plus one, zero when not queued */
+	u32 queue_pos;
+};
+
+/** Maximum number of timer events queued on one HART */
+#define SBI_TIMER_EVENT_MAX		8
+
 struct sbi_scratch;
 
 /** Generic delay loop of desired granularity */
@@ -69,6 +90,30 @@ bool sbi_timer_waitms_until(bool (*predicate)(void *), void *arg,
 /** Get timer value for current HART */
 u64 sbi_timer_value(void);
 
+#ifdef CONFIG_SBI_TIMER_FAST_TIME
+
+/**
+ * Get timer value for current HART without accessing the timer device
+ *
+ * The value is derived from mcycle. It never goes backwards and it is
+ * periodically re-anchored against the timer device.
+ */
+u64 sbi_timer_fast_value(void);
+
+/** Drop the mcycle anchor of current HART after mcycle was disturbed */
+void sbi_timer_fast_invalidate(void);
+
+#else
+
+static inline u64 sbi_timer_fast_value(void)
+{
+	return sbi_timer_value();
+}
+
+static inline void sbi_timer_fast_invalidate(void) { }
+
+#endif
+
 /** Get virtualized timer value for current HART */
 u64 sbi_timer_virt_value(void);
 
@@ -84,6 +129,21 @@ void sbi_timer_set_delta_upper(ulong delta_upper);
 /** Start timer event for current HART */
 void sbi_timer_event_start(u64 next_event);
 
+/**
+ * Queue a timer event on current HART
+ *
+ * An event which is already queued is moved to the new deadline.
+ *
+ * @param ev Timer event with a valid handler
+ * @param deadline Absolute deadline in timer ticks
+ *
+ * @return 0 on success and negative error code on failure
+ */
+int sbi_timer_event_add(struct sbi_timer_event *ev, u64 deadline);
+
+/** Remove a timer event from the queue of current HART */
+void sbi_timer_event_remove(struct sbi_timer_event *ev);
+
 /** Process timer event for current HART */
 void sbi_timer_process(void);
 
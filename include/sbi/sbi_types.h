@@ -64,6 +64,10 @@ typedef unsigned long		physical_size_t;
 #define __aligned(x)		__attribute__((aligned(x)))
 #define __always_inline	inline __attribute__((always_inline))
 
+/* Assumed cache line size used to keep per-HART data apart */
+#define SBI_CACHE_LINE_SIZE	64
+#define __cacheline_aligned	__aligned(SBI_CACHE_LINE_SIZE)
+
 #define likely(x) __builtin_expect((x), 1)
 #define unlikely(x) __builtin_expect((x), 0)
 
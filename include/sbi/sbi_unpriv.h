@@ -36,6 +36,26 @@ DECLARE_UNPRIVILEGED_LOAD_FUNCTION(u64)
 DECLARE_UNPRIVILEGED_STORE_FUNCTION(u64)
 DECLARE_UNPRIVILEGED_LOAD_FUNCTION(ulong)
 
+/**
+ * Load up to sizeof(ulong) bytes from a possibly misaligned address
+ *
+ * The access is done with naturally aligned loads in a single MPRV
+ * window. On a fault the trap details are not precise, so callers
+ * should redo the access byte by byte to find the faulting byte.
+ *
+ * @return zero extended little-endian value of the len bytes
+ */
+ulong sbi_load_unaligned(ulong addr, ulong len, struct sbi_trap_info *trap);
+
+/**
+ * Store up to sizeof(ulong) bytes to a possibly misaligned address
+ *
+ * Same fault semantics as sbi_load_unaligned(). Part of the bytes
+ * may have been written when a fault is reported.
+ */
+void sbi_store_unaligned(ulong addr, ulong val, ulong len,
+			 struct sbi_trap_info *trap);
+
 ulong sbi_get_insn(ulong mepc, struct sbi_trap_info *trap);
 
 #endif
@@ -0,0 +1,169 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * Copyright (c) 2026 agent
+ *
+ * Authors:
+ *   agent <agent@local>
+ *
+ * Boot phase profiling based on the mcycle counter.
+ */
+
+#include <libfdt.h>
+#include <sbi/riscv_asm.h>
+#include <sbi/riscv_encoding.h>
+#include <sbi/sbi_boot_prof.h>
+#include <sbi/sbi_console.h>
+#include <sbi/sbi_error.h>
+#include <sbi/sbi_scratch.h>
+#include <sbi/sbi_string.h>
+
+#define BOOT_PROF_FDT_NODE	"opensbi-boot-profile"
+
+static const char *const boot_phase_names[SBI_BOOT_PHASE_MAX] = {
+	[SBI_BOOT_PHASE_SCRATCH]		= "scratch",
+	[SBI_BOOT_PHASE_DOMAIN]			= "domain",
+	[SBI_BOOT_PHASE_HSM]			= "hsm",
+	[SBI_BOOT_PHASE_PLATFORM_EARLY]		= "platform-early",
+	[SBI_BOOT_PHASE_HART]			= "hart",
+	[SBI_BOOT_PHASE_CONSOLE]		= "console",
+	[SBI_BOOT_PHASE_PMU]			= "pmu",
+	[SBI_BOOT_PHASE_ILLEGAL_INSN]		= "illegal-insn",
+	[SBI_BOOT_PHASE_BANNER]			= "banner",
+	[SBI_BOOT_PHASE_IRQCHIP]		= "irqchip",
+	[SBI_BOOT_PHASE_IPI]			= "ipi",
+	[SBI_BOOT_PHASE_TLB]			= "tlb",
+	[SBI_BOOT_PHASE_TIMER]			= "timer",
+	[SBI_BOOT_PHASE_ECALL]			= "ecall",
+	[SBI_BOOT_PHASE_HEXT]			= "hext",
+	[SBI_BOOT_PHASE_DOMAIN_FINALIZE]	= "domain-finalize",
+	[SBI_BOOT_PHASE_PMP]			= "pmp",
+	[SBI_BOOT_PHASE_PLATFORM_FINAL]		= "platform-final",
+};
+
+/*
+ * The timer device is not usable before sbi_timer_init() so use the
+ * mcycle counter which is always accessible in M-mode.
+ */
+static u64 boot_prof_cycles(void)
+{
+#if __riscv_xlen == 32
+	u32 lo, hi, tmp;
+
+	do {
+		hi  = csr_read(CSR_MCYCLEH);
+		lo  = csr_read(CSR_MCYCLE);
+		tmp = csr_read(CSR_MCYCLEH);
+	} while (hi != tmp);
+
+	return ((u64)hi << 32) | lo;
+#else
+	return csr_read(CSR_MCYCLE);
+#endif
+}
+
+static u64 boot_prof_total(const struct sbi_boot_prof *prof)
+{
+	u64 total = 0;
+	int i;
+
+	for (i = 0; i < SBI_BOOT_PHASE_MAX; i++)
+		total += prof->cycles[i];
+
+	return total;
+}
+
+void sbi_boot_prof_start(struct sbi_boot_prof *prof)
+{
+	sbi_memset(prof->cycles, 0, sizeof(prof->cycles));
+	prof->last = boot_prof_cycles();
+}
+
+void sbi_boot_prof_mark(struct sbi_boot_prof *prof, enum sbi_boot_phase phase)
+{
+	u64 now = boot_prof_cycles();
+
+	if (phase < SBI_BOOT_PHASE_MAX)
+		prof->cycles[phase] += now - prof->last;
+	prof->last = now;
+}
+
+void sbi_boot_prof_print(struct sbi_scratch *scratch,
+			 const struct sbi_boot_prof *prof)
+{
+	int i;
+
+	if (scratch->options & SBI_SCRATCH_NO_BOOT_PRINTS)
+		return;
+
+	sbi_printf("\n");
+	for (i = 0; i < SBI_BOOT_PHASE_MAX; i++)
+		sbi_printf("Boot Phase %-15s: %llu cycles\n",
+			   boot_phase_names[i],
+			   (unsigned long long)prof->cycles[i]);
+	sbi_printf("Boot Phase %-15s: %llu cycles\n",
+		   "total", (unsigned long long)boot_prof_total(prof));
+}
+
+void sbi_boot_prof_dprint(u32 hartid, const struct sbi_boot_prof *prof)
+{
+	int i;
+
+	for (i = 0; i < SBI_BOOT_PHASE_MAX; i++) {
+		if (!prof->cycles[i])
+			continue;
+		sbi_dprintf("HART%u warm boot %s: %llu cycles\n", hartid,
+			    boot_phase_names[i],
+			    (unsigned long long)prof->cycles[i]);
+	}
+	sbi_dprintf("HART%u warm boot total: %llu cycles\n", hartid,
+		    (unsigned long long)boot_prof_total(prof));
+}
+
+int sbi_boot_prof_fdt_export(struct sbi_scratch *scratch,
+			     const struct sbi_boot_prof *prof)
+{
+	void *fdt = (void *)scratch->next_arg1;
+	fdt64_t cycles[SBI_BOOT_PHASE_MAX];
+	int i, rc, chosen, node, space;
+
+	if (fdt_check_header(fdt))
+		return SBI_EINVAL;
+
+	space = sizeof(cycles) + 3 * sizeof(struct fdt_property) +
+		sizeof(struct fdt_node_header) + sizeof(BOOT_PROF_FDT_NODE) +
+		sizeof("phases") + sizeof("cycles") + sizeof("total-cycles") +
+		sizeof(u64) + 16;
+	for (i = 0; i < SBI_BOOT_PHASE_MAX; i++)
+		space += sbi_strlen(boot_phase_names[i]) + 1;
+
+	rc = fdt_open_into(fdt, fdt, fdt_totalsize(fdt) + space);
+	if (rc)
+		return SBI_ENOSPC;
+
+	chosen = fdt_path_offset(fdt, "/chosen");
+	if (chosen < 0)
+		return SBI_ENOENT;
+
+	node = fdt_add_subnode(fdt, chosen, BOOT_PROF_FDT_NODE);
+	if (node < 0)
+		return SBI_EFAIL;
+
+	for (i = 0; i < SBI_BOOT_PHASE_MAX; i++) {
+		rc = fdt_appendprop_string(fdt, node, "phases",
+					   boot_phase_names[i]);
+		if (rc)
+			return SBI_EFAIL;
+		cycles[i] = cpu_to_fdt64(prof->cycles[i]);
+	}
+
+	rc = fdt_setprop(fdt, node, "cycles", cycles, sizeof(cycles));
+	if (rc)
+		return SBI_EFAIL;
+
+	rc = fdt_setprop_u64(fdt, node, "total-cycles", boot_prof_total(prof));
+	if (rc)
+		return SBI_EFAIL;
+
+	return 0;
+}
@@ -7,15 +7,243 @@
  *   Anup Patel <anup.patel@wdc.com>
  */
 
+#include <sbi/riscv_atomic.h>
+#include <sbi/riscv_barrier.h>
 #include <sbi/riscv_locks.h>
 #include <sbi/sbi_console.h>
 #include <sbi/sbi_hart.h>
 #include <sbi/sbi_platform.h>
 #include <sbi/sbi_scratch.h>
+#include <sbi/sbi_string.h>
 
 static const struct sbi_console_device *console_dev = NULL;
 static spinlock_t console_out_lock	       = SPIN_LOCK_INITIALIZER;
 
+/* Largest chunk handed to console_puts() at once */
+#define CONSOLE_PUTS_MAX		1024
+
+/* Formatted output waiting for console_write(), under console_out_lock */
+#define CONSOLE_TBUF_SIZE		64
+static char console_tbuf[CONSOLE_TBUF_SIZE];
+static u32 console_tbuf_len;
+
+static void console_puts_all(const char *str, unsigned long len)
+{
+	int rc;
+
+	while (len) {
+		rc = console_dev->console_puts(str, (len < CONSOLE_PUTS_MAX) ?
+						    len : CONSOLE_PUTS_MAX);
+		if (rc <= 0)
+			break;
+		str += rc;
+		len -= rc;
+	}
+}
+
+/* Write a buffer to the console device, console_out_lock must be held */
+static void console_write(const char *str, unsigned long len)
+{
+	unsigned long i;
+
+	if (!console_dev)
+		return;
+
+	if (!console_dev->console_puts) {
+		for (i = 0; i < len; i++)
+			sbi_putc(str[i]);
+		return;
+	}
+
+	while (len) {
+		/* Line ends get a carriage return as in sbi_putc() */
+		for (i = 0; i < len && str[i] != '\n'; i++)
+			;
+		console_puts_all(str, i);
+		if (i < len) {
+			console_puts_all("\r\n", 2);
+			i++;
+		}
+		str += i;
+		len -= i;
+	}
+}
+
+static void console_tbuf_flush(void)
+{
+	console_write(console_tbuf, console_tbuf_len);
+	console_tbuf_len = 0;
+}
+
+static void console_tbuf_putc(char ch)
+{
+	if (console_tbuf_len == CONSOLE_TBUF_SIZE)
+		console_tbuf_flush();
+	console_tbuf[console_tbuf_len++] = ch;
+}
+
+#ifdef CONFIG_SBI_CONSOLE_RING
+
+#define CONSOLE_RING_SIZE		512
+/* Characters written out per bounded drain, about one UART TX FIFO */
+#define CONSOLE_RING_DRAIN_CHARS	16
+
+/**
+ * Per-HART console output ring.
+ *
+ * Only the owning HART writes messages into its ring, and a message
+ * becomes visible to the draining HART once head is moved past it.
+ * Draining is serialized by console_out_lock.
+ */
+struct console_ring {
+	/* Write position of the message being formatted */
+	u32 wpos;
+	/* End of the published messages */
+	volatile u32 head;
+	/* Start of the messages not written out yet */
+	volatile u32 tail;
+	char buf[CONSOLE_RING_SIZE];
+};
+
+static unsigned long console_ring_off;
+static atomic_t console_ring_pending = ATOMIC_INITIALIZER(0);
+static bool console_ring_bypass;
+
+static struct console_ring *console_ring_thishart(void)
+{
+	if (!console_ring_off || console_ring_bypass)
+		return NULL;
+
+	return sbi_scratch_thishart_offset_ptr(console_ring_off);
+}
+
+/*
+ * Write out rings of all HARTs, console_out_lock must be held. A bounded
+ * drain stops after CONSOLE_RING_DRAIN_CHARS characters, so that a trap
+ * never waits on more than about one TX FIFO worth of output.
+ */
+static void console_ring_drain_locked(bool bounded)
+{
+	u32 i, head, tail, start, len;
+	u32 budget = CONSOLE_RING_DRAIN_CHARS;
+	struct sbi_scratch *scratch;
+	struct console_ring *ring;
+
+	atomic_write(&console_ring_pending, 0);
+
+	for (i = 0; i <= sbi_scratch_last_hartid(); i++) {
+		scratch = sbi_hartid_to_scratch(i);
+		if (!scratch)
+			continue;
+		ring = sbi_scratch_offset_ptr(scratch, console_ring_off);
+
+		head = ring->head;
+		smp_rmb();
+		tail = ring->tail;
+		while (tail != head) {
+			start = tail & (CONSOLE_RING_SIZE - 1);
+			len = head - tail;
+			if (len > CONSOLE_RING_SIZE - start)
+				len = CONSOLE_RING_SIZE - start;
+			if (bounded && len > budget)
+				len = budget;
+
+			console_write(&ring->buf[start], len);
+			tail += len;
+
+			if (bounded) {
+				budget -= len;
+				if (!budget)
+					break;
+			}
+		}
+		smp_mb();
+		ring->tail = tail;
+
+		/* More output may be left in this or the following rings */
+		if (tail != head || (bounded && !budget)) {
+			atomic_write(&console_ring_pending, 1);
+			break;
+		}
+	}
+}
+
+static void console_ring_publish(struct console_ring *ring)
+{
+	smp_wmb();
+	ring->head = ring->wpos;
+	atomic_write(&console_ring_pending, 1);
+}
+
+static void console_ring_putc(struct console_ring *ring, char ch)
+{
+	/* Full ring, fall back to writing out synchronously */
+	if (ring->wpos - ring->tail >= CONSOLE_RING_SIZE) {
+		console_ring_publish(ring);
+		sbi_console_flush();
+	}
+
+	ring->buf[ring->wpos & (CONSOLE_RING_SIZE - 1)] = ch;
+	ring->wpos++;
+}
+
+void sbi_console_drain(void)
+{
+	if (!atomic_read(&console_ring_pending))
+		return;
+
+	if (!spin_trylock(&console_out_lock))
+		return;
+	console_ring_drain_locked(true);
+	spin_unlock(&console_out_lock);
+}
+
+void sbi_console_flush(void)
+{
+	if (!console_ring_off || !atomic_read(&console_ring_pending))
+		return;
+
+	spin_lock(&console_out_lock);
+	console_ring_drain_locked(false);
+	spin_unlock(&console_out_lock);
+}
+
+#else
+
+struct console_ring;
+
+static inline struct console_ring *console_ring_thishart(void)
+{
+	return NULL;
+}
+
+static inline void console_ring_publish(struct console_ring *ring) { }
+
+static inline void console_ring_putc(struct console_ring *ring, char ch) { }
+
+#endif
+
+/* Start a message, returns the ring to format it into if there is one */
+static struct console_ring *console_out_begin(void)
+{
+	struct console_ring *ring = console_ring_thishart();
+
+	if (!ring)
+		spin_lock(&console_out_lock);
+
+	return ring;
+}
+
+static void console_out_end(struct console_ring *ring)
+{
+	if (ring) {
+		console_ring_publish(ring);
+	} else {
+		console_tbuf_flush();
+		spin_unlock(&console_out_lock);
+	}
+}
+
 bool sbi_isprintable(char c)
 {
 	if (((31 < c) && (c < 127)) || (c == '\f') || (c == '\r') ||
@@ -43,12 +271,29 @@ void sbi_putc(char ch)
 
 void sbi_puts(const char *str)
 {
-	spin_lock(&console_out_lock);
-	while (*str) {
-		sbi_putc(*str);
-		str++;
+	struct console_ring *ring = console_out_begin();
+
+	if (ring) {
+		while (*str)
+			console_ring_putc(ring, *str++);
+	} else {
+		console_write(str, sbi_strlen(str));
 	}
+	console_out_end(ring);
+}
+
+unsigned long sbi_nputs(const char *str, unsigned long len)
+{
+	spin_lock(&console_out_lock);
+#ifdef CONFIG_SBI_CONSOLE_RING
+	/* Keep buffered messages ahead of the new output */
+	if (console_ring_off)
+		console_ring_drain_locked(false);
+#endif
+	console_write(str, len);
 	spin_unlock(&console_out_lock);
+
+	return len;
 }
 
 void sbi_gets(char *s, int maxwidth, char endchar)
@@ -64,6 +309,21 @@ void sbi_gets(char *s, int maxwidth, char endchar)
 	*retval = '\0';
 }
 
+unsigned long sbi_ngets(char *str, unsigned long len)
+{
+	int ch;
+	unsigned long i;
+
+	for (i = 0; i < len; i++) {
+		ch = sbi_getc();
+		if (ch < 0)
+			break;
+		str[i] = ch;
+	}
+
+	return i;
+}
+
 #define PAD_RIGHT 1
 #define PAD_ZERO 2
 #define PAD_ALTERNATE 4
@@ -74,10 +334,14 @@ void sbi_gets(char *s, int maxwidth, char endchar)
 #define va_arg __builtin_va_arg
 typedef __builtin_va_list va_list;
 
-static void printc(char **out, u32 *out_len, char ch)
+static void printc(char **out, u32 *out_len, struct console_ring *ring,
+		   char ch)
 {
 	if (!out) {
-		sbi_putc(ch);
+		if (ring)
+			console_ring_putc(ring, ch);
+		else
+			console_tbuf_putc(ch);
 		return;
 	}
 
@@ -94,8 +358,8 @@ static void printc(char **out, u32 *out_len, char ch)
 		--(*out_len);
 }
 
-static int prints(char **out, u32 *out_len, const char *string, int width,
-		  int flags)
+static int prints(char **out, u32 *out_len, struct console_ring *ring,
+		  const char *string, int width, int flags)
 {
 	int pc	     = 0;
 	char padchar = ' ';
@@ -114,24 +378,24 @@ static int prints(char **out, u32 *out_len, const char *string, int width,
 	}
 	if (!(flags & PAD_RIGHT)) {
 		for (; width > 0; --width) {
-			printc(out, out_len, padchar);
+			printc(out, out_len, ring, padchar);
 			++pc;
 		}
 	}
 	for (; *string; ++string) {
-		printc(out, out_len, *string);
+		printc(out, out_len, ring, *string);
 		++pc;
 	}
 	for (; width > 0; --width) {
-		printc(out, out_len, padchar);
+		printc(out, out_len, ring, padchar);
 		++pc;
 	}
 
 	return pc;
 }
 
-static int printi(char **out, u32 *out_len, long long i, int b, int sg,
-		  int width, int flags, int letbase)
+static int printi(char **out, u32 *out_len, struct console_ring *ring,
+		  long long i, int b, int sg, int width, int flags, int letbase)
 {
 	char print_buf[PRINT_BUF_LEN];
 	char *s;
@@ -170,7 +434,7 @@ static int printi(char **out, u32 *out_len, long long i, int b, int sg,
 
 	if (neg) {
 		if (width && (flags & PAD_ZERO)) {
-			printc(out, out_len, '-');
+			printc(out, out_len, ring, '-');
 			++pc;
 			--width;
 		} else {
@@ -178,10 +442,15 @@ static int printi(char **out, u32 *out_len, long long i, int b, int sg,
 		}
 	}
 
-	return pc + prints(out, out_len, s, width, flags);
+	return pc + prints(out, out_len, ring, s, width, flags);
 }
 
-static int print(char **out, u32 *out_len, const char *format, va_list args)
+/*
+ * Formats into the string at out if given, otherwise into the ring chosen
+ * by console_out_begin() or, without a ring, into console_tbuf.
+ */
+static int print(char **out, u32 *out_len, struct console_ring *ring,
+		 const char *format, va_list args)
 {
 	int width, flags;
 	int pc = 0;
@@ -216,41 +485,42 @@ static int print(char **out, u32 *out_len, const char *format, va_list args)
 			}
 			if (*format == 's') {
 				char *s = va_arg(args, char *);
-				pc += prints(out, out_len, s ? s : "(null)",
-					     width, flags);
+				pc += prints(out, out_len, ring,
+					     s ? s : "(null)", width, flags);
 				continue;
 			}
 			if ((*format == 'd') || (*format == 'i')) {
-				pc += printi(out, out_len, va_arg(args, int),
-					     10, 1, width, flags, '0');
+				pc += printi(out, out_len, ring,
+					     va_arg(args, int), 10, 1,
+					     width, flags, '0');
 				continue;
 			}
 			if (*format == 'x') {
-				pc += printi(out, out_len,
+				pc += printi(out, out_len, ring,
 					     va_arg(args, unsigned int), 16, 0,
 					     width, flags, 'a');
 				continue;
 			}
 			if (*format == 'X') {
-				pc += printi(out, out_len,
+				pc += printi(out, out_len, ring,
 					     va_arg(args, unsigned int), 16, 0,
 					     width, flags, 'A');
 				continue;
 			}
 			if (*format == 'u') {
-				pc += printi(out, out_len,
+				pc += printi(out, out_len, ring,
 					     va_arg(args, unsigned int), 10, 0,
 					     width, flags, 'a');
 				continue;
 			}
 			if (*format == 'p') {
-				pc += printi(out, out_len,
+				pc += printi(out, out_len, ring,
 					     va_arg(args, unsigned long), 16, 0,
 					     width, flags, 'a');
 				continue;
 			}
 			if (*format == 'P') {
-				pc += printi(out, out_len,
+				pc += printi(out, out_len, ring,
 					     va_arg(args, unsigned long), 16, 0,
 					     width, flags, 'A');
 				continue;
@@ -259,43 +529,47 @@ static int print(char **out, u32 *out_len, const char *format, va_list args)
 				tmp = va_arg(args, unsigned long long);
 				if (*(format + 2) == 'u') {
 					format += 2;
-					pc += printi(out, out_len, tmp, 10, 0,
-						     width, flags, 'a');
+					pc += printi(out, out_len, ring, tmp,
+						     10, 0, width, flags,
+						     'a');
 				} else if (*(format + 2) == 'x') {
 					format += 2;
-					pc += printi(out, out_len, tmp, 16, 0,
-						     width, flags, 'a');
+					pc += printi(out, out_len, ring, tmp,
+						     16, 0, width, flags,
+						     'a');
 				} else if (*(format + 2) == 'X') {
 					format += 2;
-					pc += printi(out, out_len, tmp, 16, 0,
-						     width, flags, 'A');
+					pc += printi(out, out_len, ring, tmp,
+						     16, 0, width, flags,
+						     'A');
 				} else {
 					format += 1;
-					pc += printi(out, out_len, tmp, 10, 1,
-						     width, flags, '0');
+					pc += printi(out, out_len, ring, tmp,
+						     10, 1, width, flags,
+						     '0');
 				}
 				continue;
 			} else if (*format == 'l') {
 				if (*(format + 1) == 'u') {
 					format += 1;
 					pc += printi(
-						out, out_len,
+						out, out_len, ring,
 						va_arg(args, unsigned long), 10,
 						0, width, flags, 'a');
 				} else if (*(format + 1) == 'x') {
 					format += 1;
 					pc += printi(
-						out, out_len,
+						out, out_len, ring,
 						va_arg(args, unsigned long), 16,
 						0, width, flags, 'a');
 				} else if (*(format + 1) == 'X') {
 					format += 1;
 					pc += printi(
-						out, out_len,
+						out, out_len, ring,
 						va_arg(args, unsigned long), 16,
 						0, width, flags, 'A');
 				} else {
-					pc += printi(out, out_len,
+					pc += printi(out, out_len, ring,
 						     va_arg(args, long), 10, 1,
 						     width, flags, '0');
 				}
@@ -304,12 +578,13 @@ static int print(char **out, u32 *out_len, const char *format, va_list args)
 				/* char are converted to int then pushed on the stack */
 				scr[0] = va_arg(args, int);
 				scr[1] = '\0';
-				pc += prints(out, out_len, scr, width, flags);
+				pc += prints(out, out_len, ring, scr, width,
+					     flags);
 				continue;
 			}
 		} else {
 literal:
-			printc(out, out_len, *format);
+			printc(out, out_len, ring, *format);
 			++pc;
 		}
 	}
@@ -326,7 +601,7 @@ int sbi_sprintf(char *out, const char *format, ...)
 		sbi_panic("sbi_sprintf called with NULL output string\n");
 
 	va_start(args, format);
-	retval = print(&out, NULL, format, args);
+	retval = print(&out, NULL, NULL, format, args);
 	va_end(args);
 
 	return retval;
@@ -342,7 +617,7 @@ int sbi_snprintf(char *out, u32 out_sz, const char *format, ...)
 			  "output size is not zero\n");
 
 	va_start(args, format);
-	retval = print(&out, &out_sz, format, args);
+	retval = print(&out, &out_sz, NULL, format, args);
 	va_end(args);
 
 	return retval;
@@ -352,12 +627,12 @@ int sbi_printf(const char *format, ...)
 {
 	va_list args;
 	int retval;
+	struct console_ring *ring = console_out_begin();
 
-	spin_lock(&console_out_lock);
 	va_start(args, format);
-	retval = print(NULL, NULL, format, args);
+	retval = print(NULL, NULL, ring, format, args);
 	va_end(args);
-	spin_unlock(&console_out_lock);
+	console_out_end(ring);
 
 	return retval;
 }
@@ -370,9 +645,10 @@ int sbi_dprintf(const char *format, ...)
 
 	va_start(args, format);
 	if (scratch->options & SBI_SCRATCH_DEBUG_PRINTS) {
-		spin_lock(&console_out_lock);
-		retval = print(NULL, NULL, format, args);
-		spin_unlock(&console_out_lock);
+		struct console_ring *ring = console_out_begin();
+
+		retval = print(NULL, NULL, ring, format, args);
+		console_out_end(ring);
 	}
 	va_end(args);
 
@@ -384,9 +660,16 @@ void sbi_panic(const char *format, ...)
 	va_list args;
 
 	spin_lock(&console_out_lock);
+#ifdef CONFIG_SBI_CONSOLE_RING
+	/* Write out what is buffered and then print synchronously */
+	if (console_ring_off)
+		console_ring_drain_locked(false);
+	console_ring_bypass = true;
+#endif
 	va_start(args, format);
-	print(NULL, NULL, format, args);
+	print(NULL, NULL, NULL, format, args);
 	va_end(args);
+	console_tbuf_flush();
 	spin_unlock(&console_out_lock);
 
 	sbi_hart_hang();
@@ -407,5 +690,14 @@ void sbi_console_set_device(const struct sbi_console_device *dev)
 
 int sbi_console_init(struct sbi_scratch *scratch)
 {
+#ifdef CONFIG_SBI_CONSOLE_RING
+	/* Without a ring the output is written out synchronously */
+	if (!console_ring_off)
+		console_ring_off = sbi_scratch_alloc_aligned_offset(
+					"console_ring",
+					sizeof(struct console_ring),
+					SBI_CACHE_LINE_SIZE);
+#endif
+
 	return sbi_platform_console_init(sbi_platform_ptr(scratch));
 }
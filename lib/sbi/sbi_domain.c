@@ -29,6 +29,22 @@ static u32 root_memregs_count = 0;
 static struct sbi_domain_memregion root_fw_region;
 static struct sbi_domain_memregion root_memregs[ROOT_REGION_MAX + 1] = { 0 };
 
+/*
+ * Pool for the address range index of all domains. A domain which does
+ * not fit falls back to walking its memory regions.
+ */
+#define DOMAIN_RANGE_POOL_MAX	256
+static u32 domain_range_pool_used = 0;
+static struct sbi_domain_memrange domain_range_pool[DOMAIN_RANGE_POOL_MAX];
+
+/** Range found by the previous lookup on a HART */
+struct domain_range_cache {
+	const struct sbi_domain *dom;
+	const struct sbi_domain_memrange *range;
+};
+
+static unsigned long domain_range_cache_offset;
+
 struct sbi_domain root = {
 	.name = "root",
 	.possible_harts = &root_hmask,
@@ -101,13 +117,77 @@ void sbi_domain_memregion_init(unsigned long addr,
 	}
 }
 
+static unsigned long domain_memregion_end(
+				const struct sbi_domain_memregion *reg)
+{
+	return (reg->order < __riscv_xlen) ?
+		reg->base + ((1UL << reg->order) - 1) : -1UL;
+}
+
+static bool domain_range_contains(const struct sbi_domain *dom,
+				  const struct sbi_domain_memrange *range,
+				  unsigned long addr)
+{
+	if (addr < range->start)
+		return false;
+
+	return (range == &dom->ranges[dom->range_count - 1]) ||
+	       (addr < (range + 1)->start);
+}
+
+static const struct sbi_domain_memregion *domain_find_memregion(
+					const struct sbi_domain *dom,
+					unsigned long addr)
+{
+	u32 lo, hi, mid;
+	struct domain_range_cache *cache = NULL;
+	const struct sbi_domain_memrange *range;
+	const struct sbi_domain_memregion *reg;
+
+	if (!dom->ranges) {
+		sbi_domain_for_each_memregion(dom, reg) {
+			if (reg->base <= addr &&
+			    addr <= domain_memregion_end(reg))
+				return reg;
+		}
+		return NULL;
+	}
+
+	if (domain_range_cache_offset) {
+		cache = sbi_scratch_thishart_offset_ptr(
+					domain_range_cache_offset);
+		if (cache->dom == dom &&
+		    domain_range_contains(dom, cache->range, addr))
+			return cache->range->reg;
+	}
+
+	/* Last range starting at or below addr, the first one starts at 0 */
+	lo = 0;
+	hi = dom->range_count;
+	while (hi - lo > 1) {
+		mid = (lo + hi) / 2;
+		if (dom->ranges[mid].start <= addr)
+			lo = mid;
+		else
+			hi = mid;
+	}
+	range = &dom->ranges[lo];
+
+	if (cache) {
+		cache->dom = dom;
+		cache->range = range;
+	}
+
+	return range->reg;
+}
+
 bool sbi_domain_check_addr(const struct sbi_domain *dom,
 			   unsigned long addr, unsigned long mode,
 			   unsigned long access_flags)
 {
 	bool rmmio, mmio = false;
-	struct sbi_domain_memregion *reg;
-	unsigned long rstart, rend, rflags, rwx = 0, rrwx = 0;
+	const struct sbi_domain_memregion *reg;
+	unsigned long rflags, rwx = 0, rrwx = 0;
 
 	if (!dom)
 		return false;
@@ -129,25 +209,156 @@ bool sbi_domain_check_addr(const struct sbi_domain *dom,
 	if (access_flags & SBI_DOMAIN_MMIO)
 		mmio = true;
 
+	reg = domain_find_memregion(dom, addr);
+	if (!reg)
+		return (mode == PRV_M) ? true : false;
+
+	rflags = reg->flags;
+	rrwx = (mode == PRV_M ?
+		(rflags & SBI_DOMAIN_MEMREGION_M_ACCESS_MASK) :
+		(rflags & SBI_DOMAIN_MEMREGION_SU_ACCESS_MASK)
+		>> SBI_DOMAIN_MEMREGION_SU_ACCESS_SHIFT);
+
+	rmmio = (rflags & SBI_DOMAIN_MEMREGION_MMIO) ? true : false;
+	if (mmio != rmmio)
+		return false;
+
+	return ((rrwx & rwx) == rwx) ? true : false;
+}
+
+/* Start of the next piece of the address space with other permissions */
+static unsigned long domain_next_boundary(const struct sbi_domain *dom,
+					  unsigned long addr)
+{
+	u32 i;
+	unsigned long end, next = 0;
+	const struct sbi_domain_memregion *reg;
+
+	if (dom->ranges) {
+		for (i = 0; i < dom->range_count - 1; i++) {
+			if (addr < dom->ranges[i + 1].start)
+				return dom->ranges[i + 1].start;
+		}
+		return 0;
+	}
+
+	/* Zero stands for the end of the address space */
 	sbi_domain_for_each_memregion(dom, reg) {
-		rflags = reg->flags;
-		rrwx = (mode == PRV_M ?
-			(rflags & SBI_DOMAIN_MEMREGION_M_ACCESS_MASK) :
-			(rflags & SBI_DOMAIN_MEMREGION_SU_ACCESS_MASK)
-			>> SBI_DOMAIN_MEMREGION_SU_ACCESS_SHIFT);
+		if (addr < reg->base && (!next || reg->base < next))
+			next = reg->base;
+		end = domain_memregion_end(reg);
+		if (end != -1UL && addr <= end && (!next || end + 1 < next))
+			next = end + 1;
+	}
 
-		rstart = reg->base;
-		rend = (reg->order < __riscv_xlen) ?
-			rstart + ((1UL << reg->order) - 1) : -1UL;
-		if (rstart <= addr && addr <= rend) {
-			rmmio = (rflags & SBI_DOMAIN_MEMREGION_MMIO) ? true : false;
-			if (mmio != rmmio)
-				return false;
-			return ((rrwx & rwx) == rwx) ? true : false;
+	return next;
+}
+
+bool sbi_domain_check_addr_range(const struct sbi_domain *dom,
+				 unsigned long addr, unsigned long size,
+				 unsigned long mode,
+				 unsigned long access_flags)
+{
+	unsigned long max = addr + size;
+
+	if (!dom)
+		return false;
+
+	/* Wrapping around the address space is never valid */
+	if (max < addr)
+		return false;
+
+	while (addr < max) {
+		if (!sbi_domain_check_addr(dom, addr, mode, access_flags))
+			return false;
+
+		addr = domain_next_boundary(dom, addr);
+		if (!addr)
+			break;
+	}
+
+	return true;
+}
+
+bool sbi_domain_check_shmem(unsigned long addr_lo, unsigned long addr_hi,
+			    unsigned long size, unsigned long access_flags)
+{
+	if (addr_hi)
+		return false;
+
+	return sbi_domain_check_addr_range(sbi_domain_thishart_ptr(),
+					   addr_lo, size, PRV_S,
+					   access_flags);
+}
+
+/*
+ * Split the address space of a domain at every region boundary and
+ * resolve each piece to the region sbi_domain_check_addr() matches
+ * first. Regions are sorted smallest first and are either nested or
+ * disjoint, so that is the smallest region covering the piece.
+ */
+static void domain_build_ranges(struct sbi_domain *dom)
+{
+	u32 i, j, count = 0, max = 1;
+	unsigned long end;
+	struct sbi_domain_memrange *ranges, trange;
+	const struct sbi_domain_memregion *reg;
+
+	dom->ranges = NULL;
+	dom->range_count = 0;
+
+	sbi_domain_for_each_memregion(dom, reg)
+		max += 2;
+	if (DOMAIN_RANGE_POOL_MAX - domain_range_pool_used < max) {
+		sbi_printf("%s: no room to index %s regions\n",
+			   __func__, dom->name);
+		return;
+	}
+	ranges = &domain_range_pool[domain_range_pool_used];
+
+	/* Collect range start addresses */
+	ranges[count++].start = 0;
+	sbi_domain_for_each_memregion(dom, reg) {
+		ranges[count++].start = reg->base;
+		end = domain_memregion_end(reg);
+		if (end != -1UL)
+			ranges[count++].start = end + 1;
+	}
+
+	/* Sort them and drop duplicates */
+	for (i = 1; i < count; i++) {
+		trange = ranges[i];
+		for (j = i; j && trange.start < ranges[j - 1].start; j--)
+			ranges[j] = ranges[j - 1];
+		ranges[j] = trange;
+	}
+	for (i = 1, j = 0; i < count; i++) {
+		if (ranges[i].start != ranges[j].start)
+			ranges[++j] = ranges[i];
+	}
+	count = j + 1;
+
+	for (i = 0; i < count; i++) {
+		ranges[i].reg = NULL;
+		sbi_domain_for_each_memregion(dom, reg) {
+			if (reg->base <= ranges[i].start &&
+			    ranges[i].start <= domain_memregion_end(reg)) {
+				ranges[i].reg = reg;
+				break;
+			}
 		}
 	}
 
-	return (mode == PRV_M) ? true : false;
+	/* Merge neighbours resolving to the same region */
+	for (i = 1, j = 0; i < count; i++) {
+		if (ranges[i].reg != ranges[j].reg)
+			ranges[++j] = ranges[i];
+	}
+	count = j + 1;
+
+	domain_range_pool_used += count;
+	dom->range_count = count;
+	dom->ranges = ranges;
 }
 
 /* Check if region complies with constraints */
@@ -445,6 +656,10 @@ int sbi_domain_register(struct sbi_domain *dom,
 		return rc;
 	}
 
+	/* Ranges are only built once all regions are known */
+	dom->ranges = NULL;
+	dom->range_count = 0;
+
 	/* Assign index to domain */
 	dom->index = domain_count++;
 	domidx_to_domain_table[dom->index] = dom;
@@ -587,6 +802,15 @@ int sbi_domain_finalize(struct sbi_scratch *scratch, u32 cold_hartid)
 		return rc;
 	}
 
+	domain_range_cache_offset = sbi_scratch_alloc_aligned_offset(
+					"domain_range_cache",
+					sizeof(struct domain_range_cache),
+					__SIZEOF_POINTER__);
+
+	/* Index memory regions of domains */
+	sbi_domain_for_each(i, dom)
+		domain_build_ranges(dom);
+
 	/* Startup boot HART of domains */
 	sbi_domain_for_each(i, dom) {
 		/* Domain boot HART */
@@ -11,6 +11,7 @@
 #include <sbi/sbi_ecall.h>
 #include <sbi/sbi_ecall_interface.h>
 #include <sbi/sbi_error.h>
+#include <sbi/sbi_string.h>
 #include <sbi/sbi_trap.h>
 #include <sbi/sbi_hext.h>
 
@@ -41,9 +42,77 @@ void sbi_ecall_set_impid(unsigned long impid)
 
 static SBI_LIST_HEAD(ecall_exts_list);
 
+/*
+ * Open-addressed table of registered extensions keyed by extension ID,
+ * with linear probing on collisions. The legacy range, BASE and all
+ * standard extensions fit, so their ecalls never walk ecall_exts_list.
+ * Large ranges such as the vendor space are only found on the list.
+ */
+#define ECALL_TABLE_SIZE	64
+
+struct ecall_table_entry {
+	unsigned long extid;
+	struct sbi_ecall_extension *ext;
+};
+
+static struct ecall_table_entry ecall_table[ECALL_TABLE_SIZE];
+
+static inline unsigned long ecall_table_slot(unsigned long extid)
+{
+	return (extid ^ (extid >> 1)) & (ECALL_TABLE_SIZE - 1);
+}
+
+static void ecall_table_add(struct sbi_ecall_extension *ext)
+{
+	struct ecall_table_entry *e;
+	unsigned long extid, slot;
+	int i;
+
+	if (ext->extid_end - ext->extid_start >= ECALL_TABLE_SIZE)
+		return;
+
+	for (extid = ext->extid_start; extid <= ext->extid_end; extid++) {
+		slot = ecall_table_slot(extid);
+		for (i = 0; i < ECALL_TABLE_SIZE; i++) {
+			e = &ecall_table[(slot + i) & (ECALL_TABLE_SIZE - 1)];
+			if (!e->ext) {
+				e->extid = extid;
+				e->ext = ext;
+				break;
+			}
+		}
+	}
+}
+
+static void ecall_table_del(struct sbi_ecall_extension *ext)
+{
+	struct sbi_ecall_extension *t;
+
+	/*
+	 * Emptying a slot would cut the probe sequence of the IDs placed
+	 * after it, so rebuild the table from the remaining extensions.
+	 */
+	sbi_memset(ecall_table, 0, sizeof(ecall_table));
+	sbi_list_for_each_entry(t, &ecall_exts_list, head) {
+		if (t != ext)
+			ecall_table_add(t);
+	}
+}
+
 struct sbi_ecall_extension *sbi_ecall_find_extension(unsigned long extid)
 {
+	unsigned long slot = ecall_table_slot(extid);
 	struct sbi_ecall_extension *t, *ret = NULL;
+	struct ecall_table_entry *e;
+	int i;
+
+	for (i = 0; i < ECALL_TABLE_SIZE; i++) {
+		e = &ecall_table[(slot + i) & (ECALL_TABLE_SIZE - 1)];
+		if (!e->ext)
+			break;
+		if (e->extid == extid)
+			return e->ext;
+	}
 
 	sbi_list_for_each_entry(t, &ecall_exts_list, head) {
 		if (t->extid_start <= extid && extid <= t->extid_end) {
@@ -73,6 +142,7 @@ int sbi_ecall_register_extension(struct sbi_ecall_extension *ext)
 
 	SBI_INIT_LIST_HEAD(&ext->head);
 	sbi_list_add_tail(&ext->head, &ecall_exts_list);
+	ecall_table_add(ext);
 
 	return 0;
 }
@@ -92,8 +162,10 @@ void sbi_ecall_unregister_extension(struct sbi_ecall_extension *ext)
 		}
 	}
 
-	if (found)
+	if (found) {
+		ecall_table_del(ext);
 		sbi_list_del_init(&ext->head);
+	}
 }
 
 int sbi_ecall_handler(struct sbi_trap_regs *regs)
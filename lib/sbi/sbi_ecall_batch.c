@@ -0,0 +1,151 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * Copyright (c) 2026 agent
+ *
+ * Authors:
+ *   agent <agent@local>
+ *
+ * Experimental extension to submit several SBI calls in one trap.
+ */
+
+#include <sbi/sbi_domain.h>
+#include <sbi/sbi_ecall.h>
+#include <sbi/sbi_ecall_interface.h>
+#include <sbi/sbi_error.h>
+#include <sbi/sbi_trap.h>
+
+/**
+ * One SBI call in the shared memory array of a BATCH submit
+ *
+ * All fields are XLEN wide. S-mode fills extid, fid and args, the
+ * firmware writes back error and value as a normal ecall would return
+ * them in a0 and a1.
+ */
+struct sbi_batch_entry {
+	unsigned long extid;
+	unsigned long fid;
+	unsigned long args[6];
+	long error;
+	unsigned long value;
+};
+
+/*
+ * Calls which do not return to the caller, or which would need to
+ * redirect a trap in the middle of the batch, cannot be batched.
+ */
+static bool batch_call_allowed(unsigned long extid, unsigned long fid)
+{
+	if (extid <= SBI_EXT_0_1_SHUTDOWN)
+		return false;
+
+	switch (extid) {
+	case SBI_EXT_BATCH:
+	case SBI_EXT_SRST:
+		return false;
+	case SBI_EXT_HSM:
+		return fid != SBI_EXT_HSM_HART_STOP &&
+		       fid != SBI_EXT_HSM_HART_SUSPEND;
+	default:
+		return true;
+	}
+}
+
+/*
+ * S-mode can rewrite the shared array while a call runs, so each field
+ * is loaded exactly once and only the local copy is used afterwards.
+ */
+static void batch_entry_load(struct sbi_batch_entry *dst,
+			     const volatile struct sbi_batch_entry *src)
+{
+	int i;
+
+	dst->extid = src->extid;
+	dst->fid = src->fid;
+	for (i = 0; i < array_size(dst->args); i++)
+		dst->args[i] = src->args[i];
+}
+
+static void batch_call(const struct sbi_trap_regs *regs,
+		       volatile struct sbi_batch_entry *entry)
+{
+	struct sbi_ecall_extension *ext;
+	struct sbi_trap_info trap = {0};
+	struct sbi_batch_entry e;
+	struct sbi_trap_regs call;
+	unsigned long out_val = 0;
+	int ret;
+
+	batch_entry_load(&e, entry);
+
+	if (!batch_call_allowed(e.extid, e.fid)) {
+		ret = SBI_ERR_DENIED;
+		goto done;
+	}
+
+	ext = sbi_ecall_find_extension(e.extid);
+	if (!ext || !ext->handle) {
+		ret = SBI_ERR_NOT_SUPPORTED;
+		goto done;
+	}
+
+	/*
+	 * Handlers take their arguments from the trap registers so give
+	 * them a copy which carries the batched call instead.
+	 */
+	call = *regs;
+	call.a0 = e.args[0];
+	call.a1 = e.args[1];
+	call.a2 = e.args[2];
+	call.a3 = e.args[3];
+	call.a4 = e.args[4];
+	call.a5 = e.args[5];
+	call.a6 = e.fid;
+	call.a7 = e.extid;
+
+	ret = ext->handle(e.extid, e.fid, &call, &out_val, &trap);
+	if (ret == SBI_ETRAP || ret < SBI_LAST_ERR)
+		ret = SBI_ERR_FAILED;
+
+done:
+	entry->error = ret;
+	entry->value = out_val;
+}
+
+static int sbi_ecall_batch_handler(unsigned long extid, unsigned long funcid,
+				   const struct sbi_trap_regs *regs,
+				   unsigned long *out_val,
+				   struct sbi_trap_info *out_trap)
+{
+	struct sbi_batch_entry *entries;
+	unsigned long i, count;
+
+	if (funcid != SBI_EXT_BATCH_SUBMIT)
+		return SBI_ENOTSUPP;
+
+	if (regs->a1 & (sizeof(unsigned long) - 1))
+		return SBI_EINVAL;
+
+	/* Longer batches are finished by submitting the rest again */
+	count = regs->a0;
+	if (count > SBI_BATCH_MAX_ENTRIES)
+		count = SBI_BATCH_MAX_ENTRIES;
+
+	entries = (struct sbi_batch_entry *)regs->a1;
+	if (!sbi_domain_check_shmem(regs->a1, regs->a2,
+				    count * sizeof(*entries),
+				    SBI_DOMAIN_READ | SBI_DOMAIN_WRITE))
+		return SBI_EINVALID_ADDR;
+
+	for (i = 0; i < count; i++)
+		batch_call(regs, &entries[i]);
+
+	*out_val = count;
+	return 0;
+}
+
+struct sbi_ecall_extension ecall_batch = {
+	.extid_start = SBI_EXT_BATCH,
+	.extid_end = SBI_EXT_BATCH,
+	.handle = sbi_ecall_batch_handler,
+};
@@ -0,0 +1,73 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * Copyright (c) 2026 agent
+ *
+ * Authors:
+ *   agent <agent@local>
+ */
+
+#include <sbi/sbi_console.h>
+#include <sbi/sbi_domain.h>
+#include <sbi/sbi_ecall.h>
+#include <sbi/sbi_ecall_interface.h>
+#include <sbi/sbi_error.h>
+#include <sbi/sbi_trap.h>
+
+/*
+ * Bytes written per console write call. sbi_nputs() holds the console
+ * lock while writing at UART speed, so longer buffers are written in
+ * parts and the caller retries with the returned count.
+ */
+#define DBCN_WRITE_MAX		256
+
+static int sbi_ecall_dbcn_handler(unsigned long extid, unsigned long funcid,
+				  const struct sbi_trap_regs *regs,
+				  unsigned long *out_val,
+				  struct sbi_trap_info *out_trap)
+{
+	unsigned long access, len;
+	char ch;
+
+	switch (funcid) {
+	case SBI_EXT_DBCN_CONSOLE_WRITE:
+	case SBI_EXT_DBCN_CONSOLE_READ:
+		len = regs->a0;
+		if (funcid == SBI_EXT_DBCN_CONSOLE_WRITE &&
+		    len > DBCN_WRITE_MAX)
+			len = DBCN_WRITE_MAX;
+
+		access = (funcid == SBI_EXT_DBCN_CONSOLE_WRITE) ?
+			 SBI_DOMAIN_READ : SBI_DOMAIN_WRITE;
+		/* DBCN reports unusable buffers as invalid parameters */
+		if (!sbi_domain_check_shmem(regs->a1, regs->a2, len, access))
+			return SBI_EINVAL;
+
+		if (funcid == SBI_EXT_DBCN_CONSOLE_WRITE)
+			*out_val = sbi_nputs((const char *)regs->a1, len);
+		else
+			*out_val = sbi_ngets((char *)regs->a1, len);
+		return 0;
+	case SBI_EXT_DBCN_CONSOLE_WRITE_BYTE:
+		ch = regs->a0;
+		sbi_nputs(&ch, 1);
+		return 0;
+	default:
+		break;
+	}
+
+	return SBI_ENOTSUPP;
+}
+
+static int sbi_ecall_dbcn_probe(unsigned long extid, unsigned long *out_val)
+{
+	*out_val = sbi_console_get_device() ? 1 : 0;
+	return 0;
+}
+
+struct sbi_ecall_extension ecall_dbcn = {
+	.extid_start = SBI_EXT_DBCN,
+	.extid_end = SBI_EXT_DBCN,
+	.handle = sbi_ecall_dbcn_handler,
+	.probe = sbi_ecall_dbcn_probe,
+};
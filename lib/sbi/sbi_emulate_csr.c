@@ -43,181 +43,319 @@ static bool hpm_allowed(int hpm_num, ulong prev_mode, bool virt)
 	return ((cen >> hpm_num) & 1) ? true : false;
 }
 
-int sbi_emulate_csr_read(int csr_num, struct sbi_trap_regs *regs,
-			 ulong *csr_val)
-{
-	int ret = 0;
-	struct sbi_scratch *scratch = sbi_scratch_thishart_ptr();
-
-	struct hext_state *hext = sbi_hext_current_state();
-	ulong prev_mode = (regs->mstatus & MSTATUS_MPP) >> MSTATUS_MPP_SHIFT;
+/** Trapped context shared by all CSR emulation handlers */
+struct csr_emul_ctx {
+	struct sbi_trap_regs *regs;
+	struct hext_state *hext;
+	ulong prev_mode;
 	bool virt;
+};
 
-	if (misa_extension('H')) {
+typedef int (*csr_emul_read_func)(int csr_num, const struct csr_emul_ctx *ctx,
+				  ulong *csr_val);
+typedef int (*csr_emul_write_func)(int csr_num,
+				   const struct csr_emul_ctx *ctx,
+				   ulong csr_val);
+
+/** How an emulated CSR is read and written */
+struct csr_emul_ops {
+	csr_emul_read_func read;
+	csr_emul_write_func write;
+};
+
+enum csr_emul_type {
+	CSR_EMUL_NONE = 0,
+	CSR_EMUL_HTIMEDELTA,
+	CSR_EMUL_COUNTER,
+	CSR_EMUL_TIME,
 #if __riscv_xlen == 32
-		virt = (regs->mstatusH & MSTATUSH_MPV) ? true : false;
-#else
-		virt = (regs->mstatus & MSTATUS_MPV) ? true : false;
+	CSR_EMUL_HTIMEDELTAH,
+	CSR_EMUL_COUNTERH,
+	CSR_EMUL_TIMEH,
 #endif
-	} else {
-		virt = hext->available && hext->virt;
+	CSR_EMUL_HEXT,
+	CSR_EMUL_TYPE_MAX
+};
+
+static int htimedelta_read(int csr_num, const struct csr_emul_ctx *ctx,
+			   ulong *csr_val)
+{
+	if (ctx->prev_mode != PRV_S || ctx->virt)
+		return SBI_ENOTSUPP;
+
+	*csr_val = sbi_timer_get_delta();
+	return 0;
+}
+
+static int htimedelta_write(int csr_num, const struct csr_emul_ctx *ctx,
+			    ulong csr_val)
+{
+	if (ctx->prev_mode != PRV_S || ctx->virt)
+		return SBI_ENOTSUPP;
+
+	sbi_timer_set_delta(csr_val);
+	return 0;
+}
+
+/*
+ * Counter numbers backed by a machine counter CSR, TIME (number 1) is
+ * emulated separately.
+ */
+#define MCOUNTER_LIST(X)						\
+	X(0) X(2) X(3) X(4) X(5) X(6) X(7) X(8) X(9) X(10) X(11)	\
+	X(12) X(13) X(14) X(15) X(16) X(17) X(18) X(19) X(20) X(21)	\
+	X(22) X(23) X(24) X(25) X(26) X(27) X(28) X(29) X(30) X(31)
+
+/*
+ * One read stub per counter so that a counter read is a single CSR
+ * access instead of a walk through the csr_read_num() switch.
+ */
+typedef ulong (*mcounter_read_func)(void);
+
+#define DEFINE_MCOUNTER_READ(__n)					\
+	static ulong mcounter_read_##__n(void)				\
+	{								\
+		return csr_read(CSR_MCYCLE + __n);			\
 	}
+#define MCOUNTER_READ_ENTRY(__n)	[__n] = mcounter_read_##__n,
 
-	switch (csr_num) {
-	case CSR_HTIMEDELTA:
-		if (prev_mode == PRV_S && !virt)
-			*csr_val = sbi_timer_get_delta();
-		else
-			ret = SBI_ENOTSUPP;
-		break;
-	case CSR_CYCLE:
-		if (!hpm_allowed(csr_num - CSR_CYCLE, prev_mode, virt))
-			return SBI_ENOTSUPP;
-		*csr_val = csr_read(CSR_MCYCLE);
-		break;
-	case CSR_TIME:
-		/*
-		 * We emulate TIME CSR for both Host (HS/U-mode) and
-		 * Guest (VS/VU-mode).
-		 *
-		 * Faster TIME CSR reads are critical for good performance
-		 * in S-mode software so we don't check CSR permissions.
-		 */
-		*csr_val = (virt) ? sbi_timer_virt_value():
-				    sbi_timer_value();
-		break;
-	case CSR_INSTRET:
-		if (!hpm_allowed(csr_num - CSR_CYCLE, prev_mode, virt))
-			return SBI_ENOTSUPP;
-		*csr_val = csr_read(CSR_MINSTRET);
-		break;
+MCOUNTER_LIST(DEFINE_MCOUNTER_READ)
+
+static const mcounter_read_func mcounter_read[32] = {
+	MCOUNTER_LIST(MCOUNTER_READ_ENTRY)
+};
 
 #if __riscv_xlen == 32
-	case CSR_HTIMEDELTAH:
-		if (prev_mode == PRV_S && !virt)
-			*csr_val = sbi_timer_get_delta() >> 32;
-		else
-			ret = SBI_ENOTSUPP;
-		break;
-	case CSR_CYCLEH:
-		if (!hpm_allowed(csr_num - CSR_CYCLEH, prev_mode, virt))
-			return SBI_ENOTSUPP;
-		*csr_val = csr_read(CSR_MCYCLEH);
-		break;
-	case CSR_TIMEH:
-		/* Refer comments on TIME CSR above. */
-		*csr_val = (virt) ? sbi_timer_virt_value() >> 32:
-				    sbi_timer_value() >> 32;
-		break;
-	case CSR_INSTRETH:
-		if (!hpm_allowed(csr_num - CSR_CYCLEH, prev_mode, virt))
-			return SBI_ENOTSUPP;
-		*csr_val = csr_read(CSR_MINSTRETH);
-		break;
+#define DEFINE_MCOUNTERH_READ(__n)					\
+	static ulong mcounterh_read_##__n(void)				\
+	{								\
+		return csr_read(CSR_MCYCLEH + __n);			\
+	}
+#define MCOUNTERH_READ_ENTRY(__n)	[__n] = mcounterh_read_##__n,
+
+MCOUNTER_LIST(DEFINE_MCOUNTERH_READ)
+
+static const mcounter_read_func mcounterh_read[32] = {
+	MCOUNTER_LIST(MCOUNTERH_READ_ENTRY)
+};
 #endif
 
-#define switchcase_hpm(__uref, __mref, __csr)				\
-	case __csr:							\
-		if ((sbi_hart_mhpm_count(scratch) + 3) <= (__csr - __uref))\
-			return SBI_ENOTSUPP;				\
-		if (!hpm_allowed(__csr - __uref, prev_mode, virt))	\
-			return SBI_ENOTSUPP;				\
-		*csr_val = csr_read(__mref + __csr - __uref);		\
-		break;
-#define switchcase_hpm_2(__uref, __mref, __csr)			\
-	switchcase_hpm(__uref, __mref, __csr + 0)			\
-	switchcase_hpm(__uref, __mref, __csr + 1)
-#define switchcase_hpm_4(__uref, __mref, __csr)			\
-	switchcase_hpm_2(__uref, __mref, __csr + 0)			\
-	switchcase_hpm_2(__uref, __mref, __csr + 2)
-#define switchcase_hpm_8(__uref, __mref, __csr)			\
-	switchcase_hpm_4(__uref, __mref, __csr + 0)			\
-	switchcase_hpm_4(__uref, __mref, __csr + 4)
-#define switchcase_hpm_16(__uref, __mref, __csr)			\
-	switchcase_hpm_8(__uref, __mref, __csr + 0)			\
-	switchcase_hpm_8(__uref, __mref, __csr + 8)
-
-	switchcase_hpm(CSR_CYCLE, CSR_MCYCLE, CSR_HPMCOUNTER3)
-	switchcase_hpm_4(CSR_CYCLE, CSR_MCYCLE, CSR_HPMCOUNTER4)
-	switchcase_hpm_8(CSR_CYCLE, CSR_MCYCLE, CSR_HPMCOUNTER8)
-	switchcase_hpm_16(CSR_CYCLE, CSR_MCYCLE, CSR_HPMCOUNTER16)
+static int counter_read(int csr_num, const struct csr_emul_ctx *ctx,
+			ulong *csr_val)
+{
+	int hpm_num = csr_num - CSR_CYCLE;
+
+	if (hpm_num >= 3 &&
+	    (sbi_hart_mhpm_count(sbi_scratch_thishart_ptr()) + 3) <= hpm_num)
+		return SBI_ENOTSUPP;
+	if (!hpm_allowed(hpm_num, ctx->prev_mode, ctx->virt))
+		return SBI_ENOTSUPP;
+
+	*csr_val = mcounter_read[hpm_num]();
+	return 0;
+}
+
+static int time_read(int csr_num, const struct csr_emul_ctx *ctx,
+		     ulong *csr_val)
+{
+	/*
+	 * We emulate TIME CSR for both Host (HS/U-mode) and
+	 * Guest (VS/VU-mode).
+	 *
+	 * Faster TIME CSR reads are critical for good performance
+	 * in S-mode software so we don't check CSR permissions.
+	 */
+	*csr_val = sbi_timer_fast_value() +
+		   ((ctx->virt) ? sbi_timer_get_delta() : 0);
+	return 0;
+}
 
 #if __riscv_xlen == 32
-	switchcase_hpm(CSR_CYCLEH, CSR_MCYCLEH, CSR_HPMCOUNTER3H)
-	switchcase_hpm_4(CSR_CYCLEH, CSR_MCYCLEH, CSR_HPMCOUNTER4H)
-	switchcase_hpm_8(CSR_CYCLEH, CSR_MCYCLEH, CSR_HPMCOUNTER8H)
-	switchcase_hpm_16(CSR_CYCLEH, CSR_MCYCLEH, CSR_HPMCOUNTER16H)
+static int htimedeltah_read(int csr_num, const struct csr_emul_ctx *ctx,
+			    ulong *csr_val)
+{
+	if (ctx->prev_mode != PRV_S || ctx->virt)
+		return SBI_ENOTSUPP;
+
+	*csr_val = sbi_timer_get_delta() >> 32;
+	return 0;
+}
+
+static int htimedeltah_write(int csr_num, const struct csr_emul_ctx *ctx,
+			     ulong csr_val)
+{
+	if (ctx->prev_mode != PRV_S || ctx->virt)
+		return SBI_ENOTSUPP;
+
+	sbi_timer_set_delta_upper(csr_val);
+	return 0;
+}
+
+static int counterh_read(int csr_num, const struct csr_emul_ctx *ctx,
+			 ulong *csr_val)
+{
+	int hpm_num = csr_num - CSR_CYCLEH;
+
+	if (hpm_num >= 3 &&
+	    (sbi_hart_mhpm_count(sbi_scratch_thishart_ptr()) + 3) <= hpm_num)
+		return SBI_ENOTSUPP;
+	if (!hpm_allowed(hpm_num, ctx->prev_mode, ctx->virt))
+		return SBI_ENOTSUPP;
+
+	*csr_val = mcounterh_read[hpm_num]();
+	return 0;
+}
+
+static int timeh_read(int csr_num, const struct csr_emul_ctx *ctx,
+		      ulong *csr_val)
+{
+	/* Refer comments on TIME CSR above. */
+	*csr_val = (sbi_timer_fast_value() +
+		    ((ctx->virt) ? sbi_timer_get_delta() : 0)) >> 32;
+	return 0;
+}
 #endif
 
-#undef switchcase_hpm_16
-#undef switchcase_hpm_8
-#undef switchcase_hpm_4
-#undef switchcase_hpm_2
-#undef switchcase_hpm
+static bool hext_csr_allowed(int csr_num, const struct csr_emul_ctx *ctx)
+{
+	return sbi_hext_enabled() && ctx->prev_mode >= PRV_S &&
+	       (!ctx->hext->virt || csr_num == CSR_SATP);
+}
 
-	case CSR_SATP:
-		return sbi_hext_csr_read(csr_num, regs, csr_val);
+static int hext_read(int csr_num, const struct csr_emul_ctx *ctx,
+		     ulong *csr_val)
+{
+	if (!hext_csr_allowed(csr_num, ctx))
+		return SBI_ENOTSUPP;
 
-	default:
-		if ((csr_num & 0x300) == 0x200) {
-			ret = sbi_hext_csr_read(csr_num, regs, csr_val);
-		} else {
-			ret = SBI_ENOTSUPP;
-		}
-		break;
-	};
+	return sbi_hext_csr_read(ctx->hext, csr_num, ctx->regs, csr_val);
+}
 
-	if (ret)
-		sbi_dprintf("%s: hartid%d: invalid csr_num=0x%x\n",
-			    __func__, current_hartid(), csr_num);
+static int hext_write(int csr_num, const struct csr_emul_ctx *ctx,
+		      ulong csr_val)
+{
+	if (!hext_csr_allowed(csr_num, ctx))
+		return SBI_ENOTSUPP;
 
-	return ret;
+	return sbi_hext_csr_write(ctx->hext, csr_num, ctx->regs, csr_val);
 }
 
-int sbi_emulate_csr_write(int csr_num, struct sbi_trap_regs *regs,
-			  ulong csr_val)
+static const struct csr_emul_ops csr_emul_ops[CSR_EMUL_TYPE_MAX] = {
+	[CSR_EMUL_HTIMEDELTA]	= { htimedelta_read, htimedelta_write },
+	[CSR_EMUL_COUNTER]	= { counter_read, NULL },
+	[CSR_EMUL_TIME]		= { time_read, NULL },
+#if __riscv_xlen == 32
+	[CSR_EMUL_HTIMEDELTAH]	= { htimedeltah_read, htimedeltah_write },
+	[CSR_EMUL_COUNTERH]	= { counterh_read, NULL },
+	[CSR_EMUL_TIMEH]	= { timeh_read, NULL },
+#endif
+	[CSR_EMUL_HEXT]		= { hext_read, hext_write },
+};
+
+/*
+ * CSR number to emulation type map, split into 256-entry pages by the
+ * top four bits of the CSR number. Pages without emulated CSRs are NULL.
+ * All hypervisor-level CSRs ((csr_num & 0x300) == 0x200) go to the H
+ * extension emulation.
+ */
+#define CSR_EMUL_PAGE_SHIFT	8
+#define CSR_EMUL_SLOT(__csr)	((__csr) & 0xff)
+
+static const u8 csr_emul_page_1[256] = {
+	[CSR_EMUL_SLOT(CSR_SATP)] = CSR_EMUL_HEXT,
+};
+
+static const u8 csr_emul_page_hext[256] = {
+	[0x00 ... 0xff] = CSR_EMUL_HEXT,
+};
+
+static const u8 csr_emul_page_6[256] = {
+	[0x00 ... CSR_EMUL_SLOT(CSR_HTIMEDELTA) - 1] = CSR_EMUL_HEXT,
+	[CSR_EMUL_SLOT(CSR_HTIMEDELTA)] = CSR_EMUL_HTIMEDELTA,
+#if __riscv_xlen == 32
+	[CSR_EMUL_SLOT(CSR_HTIMEDELTA) + 1 ...
+	 CSR_EMUL_SLOT(CSR_HTIMEDELTAH) - 1] = CSR_EMUL_HEXT,
+	[CSR_EMUL_SLOT(CSR_HTIMEDELTAH)] = CSR_EMUL_HTIMEDELTAH,
+	[CSR_EMUL_SLOT(CSR_HTIMEDELTAH) + 1 ... 0xff] = CSR_EMUL_HEXT,
+#else
+	[CSR_EMUL_SLOT(CSR_HTIMEDELTA) + 1 ... 0xff] = CSR_EMUL_HEXT,
+#endif
+};
+
+static const u8 csr_emul_page_c[256] = {
+	[CSR_EMUL_SLOT(CSR_CYCLE)] = CSR_EMUL_COUNTER,
+	[CSR_EMUL_SLOT(CSR_TIME)] = CSR_EMUL_TIME,
+	[CSR_EMUL_SLOT(CSR_INSTRET) ...
+	 CSR_EMUL_SLOT(CSR_HPMCOUNTER31)] = CSR_EMUL_COUNTER,
+#if __riscv_xlen == 32
+	[CSR_EMUL_SLOT(CSR_CYCLEH)] = CSR_EMUL_COUNTERH,
+	[CSR_EMUL_SLOT(CSR_TIMEH)] = CSR_EMUL_TIMEH,
+	[CSR_EMUL_SLOT(CSR_INSTRETH) ...
+	 CSR_EMUL_SLOT(CSR_HPMCOUNTER31H)] = CSR_EMUL_COUNTERH,
+#endif
+};
+
+static const u8 *const csr_emul_pages[1 << (12 - CSR_EMUL_PAGE_SHIFT)] = {
+	[0x1] = csr_emul_page_1,
+	[0x2] = csr_emul_page_hext,
+	[0x6] = csr_emul_page_6,
+	[0xa] = csr_emul_page_hext,
+	[0xc] = csr_emul_page_c,
+	[0xe] = csr_emul_page_hext,
+};
+
+static const struct csr_emul_ops *csr_emul_lookup(int csr_num,
+						  struct sbi_trap_regs *regs,
+						  struct csr_emul_ctx *ctx)
 {
-	int ret = 0;
-	struct hext_state *hext = sbi_hext_current_state();
-	ulong prev_mode = (regs->mstatus & MSTATUS_MPP) >> MSTATUS_MPP_SHIFT;
-	bool virt;
+	const u8 *page;
+
+	page = csr_emul_pages[(csr_num >> CSR_EMUL_PAGE_SHIFT) & 0xf];
+	if (!page || !page[CSR_EMUL_SLOT(csr_num)])
+		return NULL;
 
+	ctx->regs = regs;
+	ctx->hext = sbi_hext_current_state();
+	ctx->prev_mode = (regs->mstatus & MSTATUS_MPP) >> MSTATUS_MPP_SHIFT;
 	if (misa_extension('H')) {
 #if __riscv_xlen == 32
-		virt = (regs->mstatusH & MSTATUSH_MPV) ? true : false;
+		ctx->virt = (regs->mstatusH & MSTATUSH_MPV) ? true : false;
 #else
-		virt = (regs->mstatus & MSTATUS_MPV) ? true : false;
+		ctx->virt = (regs->mstatus & MSTATUS_MPV) ? true : false;
 #endif
 	} else {
-		virt = hext->available && hext->virt;
+		ctx->virt = ctx->hext->available && ctx->hext->virt;
 	}
 
-	switch (csr_num) {
-	case CSR_HTIMEDELTA:
-		if (prev_mode == PRV_S && !virt)
-			sbi_timer_set_delta(csr_val);
-		else
-			ret = SBI_ENOTSUPP;
-		break;
-#if __riscv_xlen == 32
-	case CSR_HTIMEDELTAH:
-		if (prev_mode == PRV_S && !virt)
-			sbi_timer_set_delta_upper(csr_val);
-		else
-			ret = SBI_ENOTSUPP;
-		break;
-#endif
-	case CSR_SATP:
-		return sbi_hext_csr_write(csr_num, regs, csr_val);
+	return &csr_emul_ops[page[CSR_EMUL_SLOT(csr_num)]];
+}
 
-	default:
-		if ((csr_num & 0x300) == 0x200) {
-			ret = sbi_hext_csr_write(csr_num, regs, csr_val);
-		} else {
-			ret = SBI_ENOTSUPP;
-		}
-		break;
-	};
+int sbi_emulate_csr_read(int csr_num, struct sbi_trap_regs *regs,
+			 ulong *csr_val)
+{
+	int ret = SBI_ENOTSUPP;
+	struct csr_emul_ctx ctx;
+	const struct csr_emul_ops *ops = csr_emul_lookup(csr_num, regs, &ctx);
+
+	if (ops && ops->read)
+		ret = ops->read(csr_num, &ctx, csr_val);
+
+	if (ret)
+		sbi_dprintf("%s: hartid%d: invalid csr_num=0x%x\n",
+			    __func__, current_hartid(), csr_num);
+
+	return ret;
+}
+
+int sbi_emulate_csr_write(int csr_num, struct sbi_trap_regs *regs,
+			  ulong csr_val)
+{
+	int ret = SBI_ENOTSUPP;
+	struct csr_emul_ctx ctx;
+	const struct csr_emul_ops *ops = csr_emul_lookup(csr_num, regs, &ctx);
+
+	if (ops && ops->write)
+		ret = ops->write(csr_num, &ctx, csr_val);
 
 	if (ret)
 		sbi_dprintf("%s: hartid%d: invalid csr_num=0x%x\n",
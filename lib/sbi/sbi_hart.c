@@ -736,8 +736,10 @@ int sbi_hart_init(struct sbi_scratch *scratch, bool cold_boot)
 		if (misa_extension('H'))
 			sbi_hart_expected_trap = &__sbi_expected_trap_hext;
 
-		hart_features_offset = sbi_scratch_alloc_offset(
-					sizeof(struct sbi_hart_features));
+		hart_features_offset = sbi_scratch_alloc_aligned_offset(
+					"hart_features",
+					sizeof(struct sbi_hart_features),
+					__SIZEOF_POINTER__);
 		if (!hart_features_offset)
 			return SBI_ENOMEM;
 	}
@@ -751,6 +753,8 @@ int sbi_hart_init(struct sbi_scratch *scratch, bool cold_boot)
 
 void __attribute__((noreturn)) sbi_hart_hang(void)
 {
+	sbi_console_flush();
+
 	while (1)
 		wfi();
 	__builtin_unreachable();
@@ -29,17 +29,9 @@
 		sanitized;                                      \
 	})
 
-int sbi_hext_csr_read(int csr_num, struct sbi_trap_regs *regs,
-		      unsigned long *csr_val)
+int sbi_hext_csr_read(struct hext_state *hext, int csr_num,
+		      struct sbi_trap_regs *regs, unsigned long *csr_val)
 {
-	struct hext_state *hext = sbi_hext_current_state();
-	unsigned long mpp = (regs->mstatus & MSTATUS_MPP) >> MSTATUS_MPP_SHIFT;
-
-	if (!sbi_hext_enabled() || (hext->virt && csr_num != CSR_SATP) ||
-	    mpp < PRV_S) {
-		return SBI_ENOTSUPP;
-	}
-
 	switch (csr_num) {
 	case CSR_HSTATUS:
 		*csr_val = hext->hstatus;
@@ -136,16 +128,10 @@ int sbi_hext_csr_read(int csr_num, struct sbi_trap_regs *regs,
 	}
 }
 
-int sbi_hext_csr_write(int csr_num, struct sbi_trap_regs *regs,
-		       unsigned long csr_val)
+int sbi_hext_csr_write(struct hext_state *hext, int csr_num,
+		       struct sbi_trap_regs *regs, unsigned long csr_val)
 {
-	struct hext_state *hext = sbi_hext_current_state();
 	unsigned long mode, ppn;
-	unsigned long mpp = (regs->mstatus & MSTATUS_MPP) >> MSTATUS_MPP_SHIFT;
-
-	if (!sbi_hext_enabled() || (hext->virt && csr_num != CSR_SATP) ||
-	    mpp < PRV_S)
-		return SBI_ENOTSUPP;
 
 	switch (csr_num) {
 	case CSR_HSTATUS:
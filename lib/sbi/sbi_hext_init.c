@@ -81,56 +81,121 @@ static int find_main_memory(void *fdt, unsigned long *addr, unsigned long *size)
 	return SBI_OK;
 }
 
-int patch_fdt_cpu_isa(void *fdt)
+#define HEXT_FDT_TAGALIGN(x)	(((x) + FDT_TAGSIZE - 1) & ~(FDT_TAGSIZE - 1))
+
+/**
+ * FDT edits needed for the emulated hypervisor extension.
+ *
+ * Every edit is planned first so that the blob is grown only once by
+ * hext_fdt_patch(), instead of shifting the whole tree for each edit.
+ */
+struct hext_fdt_plan {
+	/* Total growth of the blob needed by all edits below */
+	int delta;
+
+	bool reserve_pt;
+	unsigned long pt_addr;
+	unsigned long pt_size;
+
+	bool move_initrd;
+	unsigned long initrd_start;
+	unsigned long initrd_end;
+};
+
+static bool fdt_node_is_cpu(void *fdt, int node)
 {
-	int err, cpu, cpus_offset, len;
-	int total_new_strings = 0;
-	const void *prop, *isa_string;
-	void *new_isa_string;
-	char *pos;
-	int append_len;
+	const void *prop;
+	int len;
+
+	prop = fdt_getprop(fdt, node, "device_type", &len);
+	return prop && strncmp(prop, "cpu", strlen("cpu")) == 0;
+}
+
+static int isa_append_len(const char *isa_string)
+{
+	/**
+	 * If riscv,isa has no underscore:
+	 * 	rv64imafdc -> rv64imafdch
+	 * If riscv,isa has underscore:
+	 * 	rv64imafdc_zicsr -> rv64imafdc_zicsr_h
+	 */
+	return sbi_strchr(isa_string, '_') ? 2 : 1;
+}
+
+/*
+ * Walk /cpus once to count the HARTs with an MMU, marking them as able
+ * to use the emulation, and to size the riscv,isa edits.
+ */
+static int hext_fdt_scan_cpus(void *fdt, struct hext_fdt_plan *plan)
+{
+	int err, cpu_offset, cpus_offset, len, count = 0;
+	const struct sbi_platform *platform = sbi_platform_thishart_ptr();
+	const char *mmu_type, *isa_string;
+	u32 hartid, hart_index;
 
 	cpus_offset = fdt_path_offset(fdt, "/cpus");
-	if (cpus_offset < 0) {
-		return SBI_ENODEV;
-	}
+	if (cpus_offset < 0)
+		return SBI_EFAIL;
 
-	fdt_for_each_subnode(cpu, fdt, cpus_offset) {
-		fdt_getprop(fdt, cpu, "riscv,isa", &len);
-		total_new_strings += len + sizeof(struct fdt_property) + 2;
+	fdt_for_each_subnode(cpu_offset, fdt, cpus_offset) {
+		if (fdt_node_is_cpu(fdt, cpu_offset)) {
+			isa_string = fdt_getprop(fdt, cpu_offset, "riscv,isa",
+						 &len);
+			if (isa_string && len > 0)
+				plan->delta += HEXT_FDT_TAGALIGN(len +
+						isa_append_len(isa_string)) -
+					       HEXT_FDT_TAGALIGN(len);
+		}
+
+		err = fdt_parse_hart_id(fdt, cpu_offset, &hartid);
+		if (err)
+			continue;
+
+		if (!fdt_node_is_enabled(fdt, cpu_offset))
+			continue;
+
+		mmu_type = fdt_getprop(fdt, cpu_offset, "mmu-type", &len);
+		if (!mmu_type || !len)
+			continue;
+
+		hart_index = sbi_platform_hart_index(platform, hartid);
+		if (hart_index == -1u)
+			continue;
+
+		count++;
+
+		hart_hext_state[hart_index].available = true;
 	}
 
-	if (cpu < 0 && cpu != -FDT_ERR_NOTFOUND) {
+	if ((cpu_offset < 0) && (cpu_offset != -FDT_ERR_NOTFOUND))
 		return SBI_EFAIL;
-	}
 
-	err = fdt_open_into(fdt, fdt, fdt_totalsize(fdt) + total_new_strings);
-	if (err < 0) {
-		return SBI_ENOMEM;
+	return count;
+}
+
+static int hext_fdt_patch_cpu_isa(void *fdt)
+{
+	int err, cpu, cpus_offset, len;
+	const void *isa_string;
+	void *new_isa_string;
+	int append_len;
+
+	cpus_offset = fdt_path_offset(fdt, "/cpus");
+	if (cpus_offset < 0) {
+		return SBI_ENODEV;
 	}
 
 	fdt_for_each_subnode(cpu, fdt, cpus_offset) {
-		prop = fdt_getprop(fdt, cpu, "device_type", &len);
-		if (!prop || strncmp(prop, "cpu", strlen("cpu")) != 0) {
+		if (!fdt_node_is_cpu(fdt, cpu))
 			continue;
-		}
 
 		isa_string = fdt_getprop(fdt, cpu, "riscv,isa", &len);
+		if (!isa_string || len <= 0)
+			continue;
 
-		/**
-		 * If riscv,isa has no underscore:
-		 * 	rv64imafdc -> rv64imafdch
-		 * If riscv,isa has underscore:
-		 * 	rv64imafdc_zicsr -> rv64imafdcu_zicsr_h
-		 */
-
-		pos = sbi_strchr(isa_string, '_');
-
-		if (pos)
-			append_len = 2;
-		else
-			append_len = 1;
+		append_len = isa_append_len(isa_string);
 
+		/* Grows in place, isa_string still points to the old value */
 		err = fdt_setprop_placeholder(fdt, cpu, "riscv,isa",
 					      len + append_len,
 					      &new_isa_string);
@@ -140,7 +205,7 @@ int patch_fdt_cpu_isa(void *fdt)
 
 		memmove(new_isa_string, isa_string, len - 1);
 
-		if (pos) {
+		if (append_len == 2) {
 			((char *)new_isa_string)[len - 1] = '_';
 			((char *)new_isa_string)[len]	  = 'h';
 			((char *)new_isa_string)[len + 1] = '\0';
@@ -158,9 +223,10 @@ int patch_fdt_cpu_isa(void *fdt)
 }
 
 static int relocate_initrd(struct sbi_scratch *scratch,
-			   unsigned long *relocate_base)
+			   unsigned long *relocate_base,
+			   struct hext_fdt_plan *plan)
 {
-	int chosen, len, rc;
+	int chosen, len, start_len;
 	void *fdt = (void *)scratch->next_arg1;
 
 	unsigned long initrd_start = 0, initrd_end = 0, initrd_new_start;
@@ -171,11 +237,11 @@ static int relocate_initrd(struct sbi_scratch *scratch,
 	if (chosen < 0)
 		goto not_found;
 
-	res = fdt_getprop(fdt, chosen, "linux,initrd-start", &len);
-	if (!res || len > sizeof(unsigned long))
+	res = fdt_getprop(fdt, chosen, "linux,initrd-start", &start_len);
+	if (!res || start_len > sizeof(unsigned long))
 		goto not_found;
 
-	for (int i = 0; i < len; i++)
+	for (int i = 0; i < start_len; i++)
 		initrd_start = (initrd_start << 8) | res[i];
 
 	res = fdt_getprop(fdt, chosen, "linux,initrd-end", &len);
@@ -196,30 +262,27 @@ static int relocate_initrd(struct sbi_scratch *scratch,
 		memmove((void *)initrd_new_start, (void *)initrd_start,
 			(initrd_end - initrd_start));
 
-		rc = fdt_open_into(fdt, fdt, fdt_totalsize(fdt) + 32);
-		if (rc < 0)
-			return SBI_EFAIL;
-
-		fdt_setprop_u64(fdt, chosen, "linux,initrd-start",
-				initrd_new_start);
-		fdt_setprop_u64(fdt, chosen, "linux,initrd-end",
-				initrd_new_start + (initrd_end - initrd_start));
-
-		return SBI_OK;
-	} else {
-		return SBI_OK;
+		/* Both properties are rewritten as u64 */
+		plan->move_initrd  = true;
+		plan->initrd_start = initrd_new_start;
+		plan->initrd_end   = initrd_new_start +
+				     (initrd_end - initrd_start);
+		plan->delta += 2 * HEXT_FDT_TAGALIGN(sizeof(u64)) -
+			       HEXT_FDT_TAGALIGN(start_len) -
+			       HEXT_FDT_TAGALIGN(len);
 	}
 
 not_found:
 	return SBI_OK;
 }
 
-static int sbi_hext_relocate(struct sbi_scratch *scratch)
+static int sbi_hext_relocate(struct sbi_scratch *scratch,
+			     struct hext_fdt_plan *plan)
 {
 	int rc;
 	unsigned long relocate_base = (unsigned long)hext_pt_start;
 
-	rc = relocate_initrd(scratch, &relocate_base);
+	rc = relocate_initrd(scratch, &relocate_base, plan);
 	if (rc)
 		return rc;
 
@@ -228,7 +291,27 @@ static int sbi_hext_relocate(struct sbi_scratch *scratch)
 	return SBI_OK;
 }
 
-static int patch_fdt_reserve(void *fdt, unsigned long addr, unsigned long size)
+/* Upper bound of the growth caused by hext_fdt_patch_reserve() */
+static int hext_fdt_reserve_delta(void *fdt)
+{
+	int delta = 0;
+
+	if (fdt_path_offset(fdt, "/reserved-memory") < 0)
+		delta += 2 * FDT_TAGSIZE +
+			 HEXT_FDT_TAGALIGN(sizeof("reserved-memory")) +
+			 3 * sizeof(struct fdt_property) + 2 * sizeof(fdt32_t) +
+			 sizeof("ranges") + sizeof("#size-cells") +
+			 sizeof("#address-cells");
+
+	delta += 2 * FDT_TAGSIZE + HEXT_FDT_TAGALIGN(sizeof("shadow-pt-resv")) +
+		 2 * sizeof(struct fdt_property) + 4 * sizeof(fdt32_t) +
+		 sizeof("reg") + sizeof("no-map");
+
+	return delta;
+}
+
+static int hext_fdt_patch_reserve(void *fdt, unsigned long addr,
+				  unsigned long size)
 {
 	int rc;
 	int parent;
@@ -240,10 +323,6 @@ static int patch_fdt_reserve(void *fdt, unsigned long addr, unsigned long size)
 	fdt32_t reg[4];
 	fdt32_t *val;
 
-	rc = fdt_open_into(fdt, fdt, fdt_totalsize(fdt) + 128);
-	if (rc < 0)
-		return SBI_EFAIL;
-
 	parent = fdt_path_offset(fdt, "/reserved-memory");
 	if (parent < 0) {
 		parent = fdt_add_subnode(fdt, 0, "reserved-memory");
@@ -292,49 +371,53 @@ static int patch_fdt_reserve(void *fdt, unsigned long addr, unsigned long size)
 	return SBI_OK;
 }
 
-static int hart_with_mmu_count(void *fdt)
+static int hext_fdt_patch_initrd(void *fdt, unsigned long start,
+				 unsigned long end)
 {
-	int err, cpu_offset, cpus_offset, len, count = 0;
-	const struct sbi_platform *platform = sbi_platform_thishart_ptr();
-	const char *mmu_type;
-	u32 hartid, hart_index;
+	int chosen;
 
-	err = fdt_open_into(fdt, fdt, fdt_totalsize(fdt) + 32);
-	if (err < 0)
+	chosen = fdt_path_offset(fdt, "/chosen");
+	if (chosen < 0)
 		return SBI_EFAIL;
 
-	cpus_offset = fdt_path_offset(fdt, "/cpus");
-	if (cpus_offset < 0)
+	if (fdt_setprop_u64(fdt, chosen, "linux,initrd-start", start) < 0 ||
+	    fdt_setprop_u64(fdt, chosen, "linux,initrd-end", end) < 0)
 		return SBI_EFAIL;
 
-	fdt_for_each_subnode(cpu_offset, fdt, cpus_offset) {
-		err = fdt_parse_hart_id(fdt, cpu_offset, &hartid);
-		if (err)
-			continue;
-
-		if (!fdt_node_is_enabled(fdt, cpu_offset))
-			continue;
+	return SBI_OK;
+}
 
-		mmu_type = fdt_getprop(fdt, cpu_offset, "mmu-type", &len);
-		if (!mmu_type || !len)
-			continue;
+/* Grow the blob once and apply all planned edits */
+static int hext_fdt_patch(void *fdt, const struct hext_fdt_plan *plan)
+{
+	int rc;
 
-		hart_index = sbi_platform_hart_index(platform, hartid);
-		if (hart_index == -1u)
-			continue;
+	rc = fdt_open_into(fdt, fdt, fdt_totalsize(fdt) + plan->delta);
+	if (rc < 0)
+		return SBI_ENOMEM;
 
-		count++;
+	rc = hext_fdt_patch_cpu_isa(fdt);
+	if (rc)
+		return rc;
 
-		hart_hext_state[hart_index].available = true;
+	if (plan->reserve_pt) {
+		rc = hext_fdt_patch_reserve(fdt, plan->pt_addr, plan->pt_size);
+		if (rc)
+			return rc;
 	}
 
-	if ((cpu_offset < 0) && (cpu_offset != -FDT_ERR_NOTFOUND))
-		return SBI_EFAIL;
+	if (plan->move_initrd) {
+		rc = hext_fdt_patch_initrd(fdt, plan->initrd_start,
+					   plan->initrd_end);
+		if (rc)
+			return rc;
+	}
 
-	return count;
+	return SBI_OK;
 }
 
-static int allocate_pt_space(struct sbi_scratch *scratch)
+static int allocate_pt_space(struct sbi_scratch *scratch,
+			     struct hext_fdt_plan *plan)
 {
 	int rc;
 	int hart_count;
@@ -342,15 +425,15 @@ static int allocate_pt_space(struct sbi_scratch *scratch)
 	unsigned long mem_end_aligned;
 	unsigned long alloc_size;
 	struct sbi_domain_memregion region;
+	void *fdt = (void *)scratch->next_arg1;
 
-	rc = find_main_memory((void *)scratch->next_arg1, &mem_start,
-			      &mem_size);
+	rc = find_main_memory(fdt, &mem_start, &mem_size);
 	if (rc)
 		return rc;
 
 	mem_end_aligned = (mem_start + mem_size) & ~(PT_ALIGN - 1);
 
-	hart_count = hart_with_mmu_count(sbi_scratch_thishart_arg1_ptr());
+	hart_count = hext_fdt_scan_cpus(fdt, plan);
 
 	if (hart_count < 0)
 		return hart_count;
@@ -377,8 +460,10 @@ static int allocate_pt_space(struct sbi_scratch *scratch)
 	hext_pt_start = region.base;
 	hext_pt_size  = (1UL << region.order) / PT_NODE_SIZE;
 
-	patch_fdt_reserve((void *)scratch->next_arg1,
-			  (unsigned long)hext_pt_start, (1UL << region.order));
+	plan->reserve_pt = true;
+	plan->pt_addr	 = (unsigned long)hext_pt_start;
+	plan->pt_size	 = 1UL << region.order;
+	plan->delta	+= hext_fdt_reserve_delta(fdt);
 
 	rc = sbi_hext_pt_init(hext_pt_start, hext_pt_size / hart_count);
 
@@ -436,6 +521,7 @@ static bool check_errata_cip_453()
 int sbi_hext_init(struct sbi_scratch *scratch, bool cold_boot)
 {
 	int rc;
+	struct hext_fdt_plan plan = { 0 };
 
 	if (!misa_extension('S')) {
 		// No supervisor mode, no need to emulate HS
@@ -459,7 +545,7 @@ int sbi_hext_init(struct sbi_scratch *scratch, bool cold_boot)
 			return SBI_OK;
 		}
 
-		rc = allocate_pt_space(scratch);
+		rc = allocate_pt_space(scratch, &plan);
 		if (rc)
 			return rc;
 
@@ -467,12 +553,12 @@ int sbi_hext_init(struct sbi_scratch *scratch, bool cold_boot)
 			return SBI_OK;
 		}
 
-		rc = patch_fdt_cpu_isa((void *)scratch->next_arg1);
+		sbi_hext_relocate(scratch, &plan);
+
+		rc = hext_fdt_patch((void *)scratch->next_arg1, &plan);
 		if (rc)
 			return rc;
 
-		sbi_hext_relocate(scratch);
-
 		sbi_printf("%s: Hypervisor extension emulation enabled.\n",
 			   __func__);
 
@@ -4,6 +4,7 @@
 
 #include <sbi/sbi_error.h>
 #include <sbi/sbi_hext.h>
+#include <sbi/sbi_illegal_insn.h>
 #include <sbi/sbi_console.h>
 #include <sbi/sbi_string.h>
 #include <sbi/riscv_locks.h>
@@ -110,4 +111,5 @@ void sbi_hext_pt_flush_all(struct pt_area_info *pt_area)
 	pt_area->free_list = (unsigned long)-1;
 	sbi_memset((void *)pt_area->pt_start, 0, PT_NODE_SIZE);
 	asm volatile("sfence.vma" ::: "memory");
+	sbi_illegal_insn_cache_flush();
 }
@@ -15,10 +15,29 @@
 
 #define MIP_S_ALL (MIP_SEIP | MIP_STIP | MIP_SSIP)
 
+#define HEXT_MSTATUS_TRAPS (MSTATUS_TVM | MSTATUS_TW | MSTATUS_TSR)
+
+/* mstatus trap controls needed to emulate the current mode */
+static unsigned long hext_mstatus_traps(const struct hext_state *hext)
+{
+	unsigned long traps = 0;
+
+	if (hext->virt) {
+		traps |= MSTATUS_TVM;
+		if (hext->hstatus & HSTATUS_VTW)
+			traps |= MSTATUS_TW;
+		if (hext->hstatus & HSTATUS_VTSR)
+			traps |= MSTATUS_TSR;
+	} else if (hext->hstatus & HSTATUS_SPV) {
+		traps |= MSTATUS_TSR;
+	}
+
+	return traps;
+}
+
 void sbi_hext_switch_virt(struct sbi_trap_regs *regs, struct hext_state *hext,
 			  bool virt)
 {
-	bool tvm, tw, tsr;
 	unsigned long sstatus, vsip;
 	struct sbi_scratch *scratch = sbi_scratch_thishart_ptr();
 
@@ -28,10 +47,6 @@ void sbi_hext_switch_virt(struct sbi_trap_regs *regs, struct hext_state *hext,
 	hext->virt = virt;
 
 	if (virt) {
-		tvm = true;
-		tw  = (hext->hstatus & HSTATUS_VTW) != 0;
-		tsr = (hext->hstatus & HSTATUS_VTSR) != 0;
-
 		sstatus = regs->mstatus & SSTATUS_WRITABLE_MASK;
 		regs->mstatus &= ~SSTATUS_WRITABLE_MASK;
 		regs->mstatus |= SSTATUS_WRITABLE_MASK & hext->sstatus;
@@ -99,10 +114,6 @@ void sbi_hext_switch_virt(struct sbi_trap_regs *regs, struct hext_state *hext,
 		if (sbi_hart_priv_version(scratch) >= SBI_HART_PRIV_VER_1_10)
 			csr_clear(CSR_MCOUNTEREN, BIT(CSR_TIME - CSR_CYCLE));
 	} else {
-		tvm = false;
-		tw  = false;
-		tsr = (hext->hstatus & HSTATUS_SPV) != 0;
-
 		sstatus = regs->mstatus & SSTATUS_WRITABLE_MASK;
 		regs->mstatus &= ~SSTATUS_WRITABLE_MASK;
 		regs->mstatus |= SSTATUS_WRITABLE_MASK & hext->sstatus;
@@ -146,18 +157,25 @@ void sbi_hext_switch_virt(struct sbi_trap_regs *regs, struct hext_state *hext,
 			csr_set(CSR_MCOUNTEREN, BIT(CSR_TIME - CSR_CYCLE));
 	}
 
-	if (tvm)
-		regs->mstatus |= MSTATUS_TVM;
-	else
-		regs->mstatus &= ~MSTATUS_TVM;
+	regs->mstatus &= ~HEXT_MSTATUS_TRAPS;
+	regs->mstatus |= hext_mstatus_traps(hext);
+}
+
+void sbi_hext_resume(void)
+{
+	struct hext_state *hext = sbi_hext_current_state();
 
-	if (tw)
-		regs->mstatus |= MSTATUS_TW;
-	else
-		regs->mstatus &= ~MSTATUS_TW;
+	if (!sbi_hext_enabled() || !hext->available)
+		return;
 
-	if (tsr)
-		regs->mstatus |= MSTATUS_TSR;
-	else
-		regs->mstatus &= ~MSTATUS_TSR;
+	/*
+	 * The emulated state lives in M-mode memory and survives the
+	 * suspend untouched, including the shadow page tables. Only the
+	 * mstatus trap controls derived from it were reset by the warm
+	 * boot path. HSM calls are never handled with V = 1 because
+	 * sbi_ecall_handler() redirects them to HS-mode, so nothing else
+	 * needs to be switched back.
+	 */
+	csr_clear(CSR_MSTATUS, HEXT_MSTATUS_TRAPS);
+	csr_set(CSR_MSTATUS, hext_mstatus_traps(hext));
 }
@@ -18,6 +18,7 @@
 #include <sbi/sbi_ecall_interface.h>
 #include <sbi/sbi_hart.h>
 #include <sbi/sbi_hartmask.h>
+#include <sbi/sbi_hext.h>
 #include <sbi/sbi_hsm.h>
 #include <sbi/sbi_init.h>
 #include <sbi/sbi_ipi.h>
@@ -29,6 +30,12 @@
 static const struct sbi_hsm_device *hsm_dev = NULL;
 static unsigned long hart_data_offset;
 
+/*
+ * HARTs in STARTED or SUSPENDED state. This is updated on every HSM state
+ * transition which changes whether a HART can take IPIs.
+ */
+static struct sbi_hartmask hsm_interruptible_harts;
+
 /** Per hart specific data to manage state transition **/
 struct sbi_hsm_data {
 	atomic_t state;
@@ -50,6 +57,19 @@ static inline int __sbi_hsm_hart_get_state(u32 hartid)
 	return atomic_read(&hdata->state);
 }
 
+static inline void hsm_set_interruptible(u32 hartid, bool interruptible)
+{
+	if (SBI_HARTMASK_MAX_BITS <= hartid)
+		return;
+
+	if (interruptible)
+		atomic_raw_set_bit(hartid,
+				   sbi_hartmask_bits(&hsm_interruptible_harts));
+	else
+		atomic_raw_clear_bit(hartid,
+				     sbi_hartmask_bits(&hsm_interruptible_harts));
+}
+
 int sbi_hsm_hart_get_state(const struct sbi_domain *dom, u32 hartid)
 {
 	if (!sbi_domain_is_assigned_hart(dom, hartid))
@@ -69,26 +89,22 @@ int sbi_hsm_hart_get_state(const struct sbi_domain *dom, u32 hartid)
 int sbi_hsm_hart_interruptible_mask(const struct sbi_domain *dom,
 				    ulong hbase, ulong *out_hmask)
 {
-	int hstate;
-	ulong i, hmask, dmask;
-	ulong hend = sbi_scratch_last_hartid() + 1;
+	ulong bword, boff, imask;
+	const unsigned long *ibits = sbi_hartmask_bits(&hsm_interruptible_harts);
 
 	*out_hmask = 0;
-	if (hend <= hbase)
+	if ((sbi_scratch_last_hartid() + 1) <= hbase)
 		return SBI_EINVAL;
-	if (BITS_PER_LONG < (hend - hbase))
-		hend = hbase + BITS_PER_LONG;
-
-	dmask = sbi_domain_get_assigned_hartmask(dom, hbase);
-	for (i = hbase; i < hend; i++) {
-		hmask = 1UL << (i - hbase);
-		if (dmask & hmask) {
-			hstate = __sbi_hsm_hart_get_state(i);
-			if (hstate == SBI_HSM_STATE_STARTED ||
-			    hstate == SBI_HSM_STATE_SUSPENDED)
-				*out_hmask |= hmask;
-		}
-	}
+
+	bword = BIT_WORD(hbase);
+	boff = BIT_WORD_OFFSET(hbase);
+
+	imask = ibits[bword++] >> boff;
+	if (boff && bword < BIT_WORD(SBI_HARTMASK_MAX_BITS))
+		imask |= (ibits[bword] & (BIT(boff) - 1UL)) <<
+			 (BITS_PER_LONG - boff);
+
+	*out_hmask = imask & sbi_domain_get_assigned_hartmask(dom, hbase);
 
 	return 0;
 }
@@ -103,6 +119,8 @@ void sbi_hsm_prepare_next_jump(struct sbi_scratch *scratch, u32 hartid)
 				  SBI_HSM_STATE_STARTED);
 	if (oldstate != SBI_HSM_STATE_START_PENDING)
 		sbi_hart_hang();
+
+	hsm_set_interruptible(hartid, true);
 }
 
 static void sbi_hsm_hart_wait(struct sbi_scratch *scratch, u32 hartid)
@@ -119,6 +137,8 @@ static void sbi_hsm_hart_wait(struct sbi_scratch *scratch, u32 hartid)
 	/* Wait for state transition requested by sbi_hsm_hart_start() */
 	while (atomic_read(&hdata->state) != SBI_HSM_STATE_START_PENDING) {
 		wfi();
+		/* Do not hold back IPIs other HARTs left with us */
+		sbi_ipi_process_forward();
 	};
 
 	/* Restore MIE CSR */
@@ -191,10 +211,13 @@ int sbi_hsm_init(struct sbi_scratch *scratch, u32 hartid, bool cold_boot)
 	struct sbi_hsm_data *hdata;
 
 	if (cold_boot) {
-		hart_data_offset = sbi_scratch_alloc_offset(sizeof(*hdata));
+		hart_data_offset = sbi_scratch_alloc_aligned_offset("hsm",
+					sizeof(*hdata), SBI_CACHE_LINE_SIZE);
 		if (!hart_data_offset)
 			return SBI_ENOMEM;
 
+		SBI_HARTMASK_INIT(&hsm_interruptible_harts);
+
 		/* Initialize hart state data for every hart */
 		for (i = 0; i <= sbi_scratch_last_hartid(); i++) {
 			rscratch = sbi_hartid_to_scratch(i);
@@ -314,6 +337,8 @@ int sbi_hsm_hart_stop(struct sbi_scratch *scratch, bool exitnow)
 		return SBI_EFAIL;
 	}
 
+	hsm_set_interruptible(current_hartid(), false);
+
 	if (exitnow)
 		sbi_exit(scratch);
 
@@ -358,6 +383,18 @@ static void __sbi_hsm_suspend_non_ret_restore(struct sbi_scratch *scratch)
 
 	csr_write(CSR_MIE, hdata->saved_mie);
 	csr_write(CSR_MIP, (hdata->saved_mip & (MIP_SSIP | MIP_STIP)));
+
+	/*
+	 * The resume path skips sbi_timer_init() and mcycle may have been
+	 * stopped or reset while the HART was powered down.
+	 */
+	sbi_timer_fast_invalidate();
+
+	/*
+	 * The resume path skips sbi_hext_init() so the emulated H
+	 * extension state, shadow page tables included, is kept as is.
+	 */
+	sbi_hext_resume();
 }
 
 void sbi_hsm_hart_resume_start(struct sbi_scratch *scratch)
@@ -375,6 +412,8 @@ void sbi_hsm_hart_resume_start(struct sbi_scratch *scratch)
 		sbi_hart_hang();
 	}
 
+	hsm_set_interruptible(current_hartid(), false);
+
 	hsm_device_hart_resume();
 }
 
@@ -393,6 +432,8 @@ void sbi_hsm_hart_resume_finish(struct sbi_scratch *scratch)
 		sbi_hart_hang();
 	}
 
+	hsm_set_interruptible(current_hartid(), true);
+
 	/*
 	 * Restore some of the M-mode CSRs which we are re-configured by
 	 * the warm-boot sequence.
@@ -466,6 +507,9 @@ int sbi_hsm_hart_suspend(struct sbi_scratch *scratch, u32 suspend_type,
 		}
 	}
 
+	/* mcycle may have stopped while the HART was suspended */
+	sbi_timer_fast_invalidate();
+
 	/*
 	 * The platform may have coordinated a retentive suspend, or it may
 	 * have exited early from a non-retentive suspend. Either way, the
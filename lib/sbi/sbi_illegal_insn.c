@@ -16,12 +16,32 @@
 #include <sbi/sbi_hext.h>
 #include <sbi/sbi_illegal_insn.h>
 #include <sbi/sbi_pmu.h>
+#include <sbi/sbi_scratch.h>
 #include <sbi/sbi_trap.h>
 #include <sbi/sbi_unpriv.h>
 #include <sbi/sbi_console.h>
 
 typedef int (*illegal_insn_func)(ulong insn, struct sbi_trap_regs *regs);
 
+#define ILLEGAL_INSN_CACHE_ENTRIES	8
+
+/** Previously fetched and decoded illegal instruction */
+struct illegal_insn_cache_entry {
+	ulong mepc;
+	ulong satp;
+	ulong insn;
+	illegal_insn_func func;
+};
+
+/** Per-HART cache of illegal instructions indexed by trapping PC */
+struct illegal_insn_cache {
+	/* Bitmap of valid entries */
+	ulong valid;
+	struct illegal_insn_cache_entry entries[ILLEGAL_INSN_CACHE_ENTRIES];
+};
+
+static unsigned long insn_cache_off;
+
 static int truly_illegal_insn(ulong insn, struct sbi_trap_regs *regs)
 {
 	struct sbi_trap_info trap;
@@ -146,9 +166,74 @@ static const illegal_insn_func illegal_insn_table[32] = {
 	truly_illegal_insn  /* 31 */
 };
 
+static struct illegal_insn_cache *insn_cache_thishart_ptr(void)
+{
+	if (unlikely(!insn_cache_off))
+		return NULL;
+
+	return sbi_scratch_thishart_offset_ptr(insn_cache_off);
+}
+
+/**
+ * Address space the trapping PC belongs to
+ *
+ * Without a native H extension the real satp also tells the emulated
+ * V=0 and V=1 address spaces apart, since each mode keeps its own satp
+ * while active. With a native H extension traps from V=1 are not cached.
+ */
+static bool insn_cache_satp(struct sbi_trap_regs *regs, ulong *satp)
+{
+	if (misa_extension('H')) {
+#if __riscv_xlen == 32
+		if (regs->mstatusH & MSTATUSH_MPV)
+			return false;
+#else
+		if (regs->mstatus & MSTATUS_MPV)
+			return false;
+#endif
+	}
+
+	*satp = csr_read(CSR_SATP);
+	if (!misa_extension('H') && sbi_hext_current_state()->virt)
+		*satp = ~*satp;
+
+	return true;
+}
+
+void sbi_illegal_insn_cache_flush(void)
+{
+	struct illegal_insn_cache *cache = insn_cache_thishart_ptr();
+
+	if (cache)
+		cache->valid = 0;
+}
+
+int sbi_illegal_insn_init(struct sbi_scratch *scratch, bool cold_boot)
+{
+	struct illegal_insn_cache *cache;
+
+	if (cold_boot) {
+		insn_cache_off = sbi_scratch_alloc_aligned_offset("insn_cache",
+					sizeof(*cache), __SIZEOF_POINTER__);
+		if (!insn_cache_off)
+			return SBI_ENOMEM;
+	} else if (!insn_cache_off) {
+		return SBI_ENOMEM;
+	}
+
+	cache = sbi_scratch_offset_ptr(scratch, insn_cache_off);
+	cache->valid = 0;
+
+	return 0;
+}
+
 int sbi_illegal_insn_handler(ulong insn, struct sbi_trap_regs *regs)
 {
 	struct sbi_trap_info uptrap;
+	struct illegal_insn_cache *cache = insn_cache_thishart_ptr();
+	struct illegal_insn_cache_entry *entry = NULL;
+	ulong satp = 0;
+	u32 idx = 0;
 
 	/*
 	 * We only deal with 32-bit (or longer) illegal instructions. If we
@@ -162,14 +247,36 @@ int sbi_illegal_insn_handler(ulong insn, struct sbi_trap_regs *regs)
 	 */
 
 	sbi_pmu_ctr_incr_fw(SBI_PMU_FW_ILLEGAL_INSN);
-	if (unlikely((insn & 3) != 3)) {
-		insn = sbi_get_insn(regs->mepc, &uptrap);
-		if (uptrap.cause) {
-			uptrap.epc = regs->mepc;
-			return sbi_trap_redirect(regs, &uptrap);
-		}
-		if ((insn & 3) != 3)
-			return truly_illegal_insn(insn, regs);
+
+	/*
+	 * Some implementations (QEMU 7.0.0) sometimes report a wrong
+	 * instruction in MTVAL, so it is only trusted when it matches
+	 * what an earlier fetch found at the same PC in the same address
+	 * space. Otherwise the instruction is fetched again.
+	 */
+	if (cache && insn_cache_satp(regs, &satp)) {
+		idx = (regs->mepc >> 1) % ILLEGAL_INSN_CACHE_ENTRIES;
+		entry = &cache->entries[idx];
+		if ((cache->valid & BIT(idx)) && (insn & 3) == 3 &&
+		    entry->insn == insn && entry->mepc == regs->mepc &&
+		    entry->satp == satp)
+			return entry->func(insn, regs);
+	}
+
+	insn = sbi_get_insn(regs->mepc, &uptrap);
+	if (uptrap.cause) {
+		uptrap.epc = regs->mepc;
+		return sbi_trap_redirect(regs, &uptrap);
+	}
+	if ((insn & 3) != 3)
+		return truly_illegal_insn(insn, regs);
+
+	if (entry) {
+		entry->mepc = regs->mepc;
+		entry->satp = satp;
+		entry->insn = insn;
+		entry->func = illegal_insn_table[(insn & 0x7c) >> 2];
+		cache->valid |= BIT(idx);
 	}
 
 	return illegal_insn_table[(insn & 0x7c) >> 2](insn, regs);
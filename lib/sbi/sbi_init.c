@@ -11,6 +11,7 @@
 #include <sbi/riscv_atomic.h>
 #include <sbi/riscv_barrier.h>
 #include <sbi/riscv_locks.h>
+#include <sbi/sbi_boot_prof.h>
 #include <sbi/sbi_console.h>
 #include <sbi/sbi_domain.h>
 #include <sbi/sbi_ecall.h>
@@ -18,6 +19,7 @@
 #include <sbi/sbi_hart.h>
 #include <sbi/sbi_hartmask.h>
 #include <sbi/sbi_hsm.h>
+#include <sbi/sbi_illegal_insn.h>
 #include <sbi/sbi_ipi.h>
 #include <sbi/sbi_irqchip.h>
 #include <sbi/sbi_platform.h>
@@ -126,6 +128,16 @@ static void sbi_boot_print_domains(struct sbi_scratch *scratch)
 	sbi_domain_dump_all("      ");
 }
 
+static void sbi_boot_print_scratch(struct sbi_scratch *scratch)
+{
+	if (scratch->options & SBI_SCRATCH_NO_BOOT_PRINTS)
+		return;
+
+	/* Per-HART scratch space usage */
+	sbi_printf("\n");
+	sbi_scratch_dump("      ");
+}
+
 static void sbi_boot_print_hart(struct sbi_scratch *scratch, u32 hartid)
 {
 	int xlen;
@@ -260,43 +272,60 @@ static void __noreturn init_coldboot(struct sbi_scratch *scratch, u32 hartid)
 {
 	int rc;
 	unsigned long *init_count;
+	struct sbi_boot_prof prof;
 	const struct sbi_platform *plat = sbi_platform_ptr(scratch);
 
+	sbi_boot_prof_start(&prof);
+
 	/* Note: This has to be first thing in coldboot init sequence */
 	rc = sbi_scratch_init(scratch);
 	if (rc)
 		sbi_hart_hang();
+	sbi_boot_prof_mark(&prof, SBI_BOOT_PHASE_SCRATCH);
 
 	/* Note: This has to be second thing in coldboot init sequence */
 	rc = sbi_domain_init(scratch, hartid);
 	if (rc)
 		sbi_hart_hang();
+	sbi_boot_prof_mark(&prof, SBI_BOOT_PHASE_DOMAIN);
 
-	init_count_offset = sbi_scratch_alloc_offset(__SIZEOF_POINTER__);
+	init_count_offset = sbi_scratch_alloc_aligned_offset("init_count",
+					__SIZEOF_POINTER__, __SIZEOF_POINTER__);
 	if (!init_count_offset)
 		sbi_hart_hang();
 
 	rc = sbi_hsm_init(scratch, hartid, true);
 	if (rc)
 		sbi_hart_hang();
+	sbi_boot_prof_mark(&prof, SBI_BOOT_PHASE_HSM);
 
 	rc = sbi_platform_early_init(plat, true);
 	if (rc)
 		sbi_hart_hang();
+	sbi_boot_prof_mark(&prof, SBI_BOOT_PHASE_PLATFORM_EARLY);
 
 	rc = sbi_hart_init(scratch, true);
 	if (rc)
 		sbi_hart_hang();
+	sbi_boot_prof_mark(&prof, SBI_BOOT_PHASE_HART);
 
 	rc = sbi_console_init(scratch);
 	if (rc)
 		sbi_hart_hang();
+	sbi_boot_prof_mark(&prof, SBI_BOOT_PHASE_CONSOLE);
 
 	rc = sbi_pmu_init(scratch, true);
 	if (rc)
 		sbi_hart_hang();
+	sbi_boot_prof_mark(&prof, SBI_BOOT_PHASE_PMU);
+
+	rc = sbi_illegal_insn_init(scratch, true);
+	if (rc)
+		sbi_hart_hang();
+	sbi_boot_prof_mark(&prof, SBI_BOOT_PHASE_ILLEGAL_INSN);
 
 	sbi_boot_print_banner(scratch);
+	sbi_boot_prof_mark(&prof, SBI_BOOT_PHASE_BANNER);
 
 	rc = sbi_irqchip_init(scratch, true);
 	if (rc) {
@@ -304,32 +333,38 @@ static void __noreturn init_coldboot(struct sbi_scratch *scratch, u32 hartid)
 			   __func__, rc);
 		sbi_hart_hang();
 	}
+	sbi_boot_prof_mark(&prof, SBI_BOOT_PHASE_IRQCHIP);
 
 	rc = sbi_ipi_init(scratch, true);
 	if (rc) {
 		sbi_printf("%s: ipi init failed (error %d)\n", __func__, rc);
 		sbi_hart_hang();
 	}
+	sbi_boot_prof_mark(&prof, SBI_BOOT_PHASE_IPI);
 
 	rc = sbi_tlb_init(scratch, true);
 	if (rc) {
 		sbi_printf("%s: tlb init failed (error %d)\n", __func__, rc);
 		sbi_hart_hang();
 	}
+	sbi_boot_prof_mark(&prof, SBI_BOOT_PHASE_TLB);
 
 	rc = sbi_timer_init(scratch, true);
 	if (rc) {
 		sbi_printf("%s: timer init failed (error %d)\n", __func__, rc);
 		sbi_hart_hang();
 	}
+	sbi_boot_prof_mark(&prof, SBI_BOOT_PHASE_TIMER);
 
 	rc = sbi_ecall_init();
 	if (rc) {
 		sbi_printf("%s: ecall init failed (error %d)\n", __func__, rc);
 		sbi_hart_hang();
 	}
+	sbi_boot_prof_mark(&prof, SBI_BOOT_PHASE_ECALL);
 
 	rc = sbi_hext_init(scratch, true);
+	sbi_boot_prof_mark(&prof, SBI_BOOT_PHASE_HEXT);
 
 	if (rc) {
 		sbi_printf(
@@ -350,6 +385,7 @@ static void __noreturn init_coldboot(struct sbi_scratch *scratch, u32 hartid)
 			   __func__, rc);
 		sbi_hart_hang();
 	}
+	sbi_boot_prof_mark(&prof, SBI_BOOT_PHASE_DOMAIN_FINALIZE);
 
 	rc = sbi_hart_pmp_configure(scratch);
 	if (rc) {
@@ -357,6 +393,7 @@ static void __noreturn init_coldboot(struct sbi_scratch *scratch, u32 hartid)
 			   __func__, rc);
 		sbi_hart_hang();
 	}
+	sbi_boot_prof_mark(&prof, SBI_BOOT_PHASE_PMP);
 
 	/*
 	 * Note: Platform final initialization should be last so that
@@ -368,6 +405,7 @@ static void __noreturn init_coldboot(struct sbi_scratch *scratch, u32 hartid)
 			   __func__, rc);
 		sbi_hart_hang();
 	}
+	sbi_boot_prof_mark(&prof, SBI_BOOT_PHASE_PLATFORM_FINAL);
 
 	sbi_boot_print_general(scratch);
 
@@ -377,12 +415,21 @@ static void __noreturn init_coldboot(struct sbi_scratch *scratch, u32 hartid)
 
 	sbi_boot_print_hext(scratch);
 
+	sbi_boot_print_scratch(scratch);
+
+	rc = sbi_boot_prof_fdt_export(scratch, &prof);
+	if (rc)
+		sbi_printf("%s: boot profile export failed (error %d)\n",
+			   __func__, rc);
+	sbi_boot_prof_print(scratch, &prof);
+
 	wake_coldboot_harts(scratch, hartid);
 
 	init_count = sbi_scratch_offset_ptr(scratch, init_count_offset);
 	(*init_count)++;
 
 	sbi_hsm_prepare_next_jump(scratch, hartid);
+	sbi_console_flush();
 	sbi_hart_switch_mode(hartid, scratch->next_arg1, scratch->next_addr,
 			     scratch->next_mode, false);
 }
@@ -391,58 +438,79 @@ static void init_warm_startup(struct sbi_scratch *scratch, u32 hartid)
 {
 	int rc;
 	unsigned long *init_count;
+	struct sbi_boot_prof prof;
 	const struct sbi_platform *plat = sbi_platform_ptr(scratch);
 
 	if (!init_count_offset)
 		sbi_hart_hang();
 
+	sbi_boot_prof_start(&prof);
+
 	rc = sbi_hsm_init(scratch, hartid, false);
 	if (rc)
 		sbi_hart_hang();
+	sbi_boot_prof_mark(&prof, SBI_BOOT_PHASE_HSM);
 
 	rc = sbi_platform_early_init(plat, false);
 	if (rc)
 		sbi_hart_hang();
+	sbi_boot_prof_mark(&prof, SBI_BOOT_PHASE_PLATFORM_EARLY);
 
 	rc = sbi_hart_init(scratch, false);
 	if (rc)
 		sbi_hart_hang();
+	sbi_boot_prof_mark(&prof, SBI_BOOT_PHASE_HART);
 
 	rc = sbi_pmu_init(scratch, false);
 	if (rc)
 		sbi_hart_hang();
+	sbi_boot_prof_mark(&prof, SBI_BOOT_PHASE_PMU);
+
+	rc = sbi_illegal_insn_init(scratch, false);
+	if (rc)
+		sbi_hart_hang();
+	sbi_boot_prof_mark(&prof, SBI_BOOT_PHASE_ILLEGAL_INSN);
 
 	rc = sbi_irqchip_init(scratch, false);
 	if (rc)
 		sbi_hart_hang();
+	sbi_boot_prof_mark(&prof, SBI_BOOT_PHASE_IRQCHIP);
 
 	rc = sbi_ipi_init(scratch, false);
 	if (rc)
 		sbi_hart_hang();
+	sbi_boot_prof_mark(&prof, SBI_BOOT_PHASE_IPI);
 
 	rc = sbi_tlb_init(scratch, false);
 	if (rc)
 		sbi_hart_hang();
+	sbi_boot_prof_mark(&prof, SBI_BOOT_PHASE_TLB);
 
 	rc = sbi_timer_init(scratch, false);
 	if (rc)
 		sbi_hart_hang();
+	sbi_boot_prof_mark(&prof, SBI_BOOT_PHASE_TIMER);
 
 	rc = sbi_hext_init(scratch, false);
 	if (rc)
 		sbi_hart_hang();
+	sbi_boot_prof_mark(&prof, SBI_BOOT_PHASE_HEXT);
 
 	rc = sbi_hart_pmp_configure(scratch);
 	if (rc)
 		sbi_hart_hang();
+	sbi_boot_prof_mark(&prof, SBI_BOOT_PHASE_PMP);
 
 	rc = sbi_platform_final_init(plat, false);
 	if (rc)
 		sbi_hart_hang();
+	sbi_boot_prof_mark(&prof, SBI_BOOT_PHASE_PLATFORM_FINAL);
 
 	init_count = sbi_scratch_offset_ptr(scratch, init_count_offset);
 	(*init_count)++;
 
+	sbi_boot_prof_dprint(hartid, &prof);
+
 	sbi_hsm_prepare_next_jump(scratch, hartid);
 }
 
@@ -478,6 +546,7 @@ static void __noreturn init_warmboot(struct sbi_scratch *scratch, u32 hartid)
 	else
 		init_warm_startup(scratch, hartid);
 
+	sbi_console_flush();
 	sbi_hart_switch_mode(hartid, scratch->next_arg1,
 			     scratch->next_addr,
 			     scratch->next_mode, false);
@@ -20,29 +20,33 @@
 #include <sbi/sbi_ipi.h>
 #include <sbi/sbi_platform.h>
 #include <sbi/sbi_pmu.h>
+#include <sbi/sbi_scratch.h>
 #include <sbi/sbi_string.h>
 #include <sbi/sbi_tlb.h>
 
 struct sbi_ipi_data {
 	unsigned long ipi_type;
+	/* HARTs of the same cluster to which this HART forwards the IPI */
+	struct sbi_hartmask forward;
 };
 
 static unsigned long ipi_data_off;
 static const struct sbi_ipi_device *ipi_dev = NULL;
 static const struct sbi_ipi_event_ops *ipi_ops_array[SBI_IPI_EVENT_MAX];
 
-static int sbi_ipi_send(struct sbi_scratch *scratch, u32 remote_hartid,
-			u32 event, void *data)
+/* Cluster of each HART used for hierarchical IPI delivery */
+static u32 ipi_hart_cluster[SBI_HARTMASK_MAX_BITS] = {
+	[0 ... SBI_HARTMASK_MAX_BITS - 1] = SBI_IPI_CLUSTER_NONE
+};
+static bool ipi_clusters_present = false;
+
+static int sbi_ipi_update(struct sbi_scratch *scratch, u32 remote_hartid,
+			  u32 event, void *data)
 {
 	int ret;
 	struct sbi_scratch *remote_scratch = NULL;
 	struct sbi_ipi_data *ipi_data;
-	const struct sbi_ipi_event_ops *ipi_ops;
-
-	if ((SBI_IPI_EVENT_MAX <= event) ||
-	    !ipi_ops_array[event])
-		return SBI_EINVAL;
-	ipi_ops = ipi_ops_array[event];
+	const struct sbi_ipi_event_ops *ipi_ops = ipi_ops_array[event];
 
 	remote_scratch = sbi_hartid_to_scratch(remote_hartid);
 	if (!remote_scratch)
@@ -57,59 +61,174 @@ static int sbi_ipi_send(struct sbi_scratch *scratch, u32 remote_hartid,
 			return ret;
 	}
 
-	/*
-	 * Set IPI type on remote hart's scratch area and
-	 * trigger the interrupt
-	 */
+	/* Set IPI type on remote hart's scratch area */
 	atomic_raw_set_bit(event, &ipi_data->ipi_type);
-	smp_wmb();
 
-	if (ipi_dev && ipi_dev->ipi_send)
-		ipi_dev->ipi_send(remote_hartid);
+	return 0;
+}
+
+static void sbi_ipi_update_many(struct sbi_scratch *scratch,
+				ulong hmask, ulong hbase, u32 event, void *data,
+				struct sbi_hartmask *target_mask)
+{
+	ulong i;
 
-	sbi_pmu_ctr_incr_fw(SBI_PMU_FW_IPI_SENT);
+	for (i = hbase; hmask; i++, hmask >>= 1) {
+		if ((hmask & 1UL) && !sbi_ipi_update(scratch, i, event, data))
+			sbi_hartmask_set_hart(i, target_mask);
+	}
+}
 
-	if (ipi_ops->sync)
-		ipi_ops->sync(scratch);
+static void sbi_ipi_trigger_direct(const struct sbi_hartmask *target_mask)
+{
+	u32 i;
 
-	return 0;
+	if (!ipi_dev)
+		return;
+
+	if (ipi_dev->ipi_send_mask) {
+		ipi_dev->ipi_send_mask(target_mask);
+	} else if (ipi_dev->ipi_send) {
+		sbi_hartmask_for_each_hart(i, target_mask)
+			ipi_dev->ipi_send(i);
+	}
+}
+
+/**
+ * Trigger IPIs hierarchically when the HARTs are grouped into clusters.
+ *
+ * Only the first target HART of each remote cluster (the leader) receives an
+ * IPI from the source HART. The remaining targets of that cluster are marked
+ * in the forward mask of the leader, which triggers their IPIs locally as
+ * soon as it takes its own IPI. Targets in the cluster of the source HART or
+ * without a cluster are sent IPIs directly.
+ */
+static void sbi_ipi_trigger(const struct sbi_hartmask *target_mask)
+{
+	u32 i, cluster, seen = 0;
+	u32 this_cluster = ipi_hart_cluster[current_hartid()];
+	u32 leader[SBI_IPI_CLUSTER_MAX];
+	struct sbi_hartmask direct_mask;
+	struct sbi_scratch *leader_scratch;
+	struct sbi_ipi_data *leader_data;
+
+	if (!ipi_clusters_present) {
+		sbi_ipi_trigger_direct(target_mask);
+		return;
+	}
+
+	SBI_HARTMASK_INIT(&direct_mask);
+
+	sbi_hartmask_for_each_hart(i, target_mask) {
+		cluster = ipi_hart_cluster[i];
+		if (cluster == SBI_IPI_CLUSTER_NONE || cluster == this_cluster) {
+			sbi_hartmask_set_hart(i, &direct_mask);
+			continue;
+		}
+
+		/* leader[] entries are only valid once seen in this call */
+		if (!(seen & BIT(cluster))) {
+			seen |= BIT(cluster);
+			leader[cluster] = i;
+			sbi_hartmask_set_hart(i, &direct_mask);
+			continue;
+		}
+
+		leader_scratch = sbi_hartid_to_scratch(leader[cluster]);
+		leader_data = sbi_scratch_offset_ptr(leader_scratch,
+						     ipi_data_off);
+		atomic_raw_set_bit(i, sbi_hartmask_bits(&leader_data->forward));
+	}
+
+	sbi_ipi_trigger_direct(&direct_mask);
+}
+
+static void ipi_process_forward(struct sbi_ipi_data *ipi_data)
+{
+	u32 i;
+	bool forward = false;
+	struct sbi_hartmask forward_mask;
+	unsigned long *bits = sbi_hartmask_bits(&ipi_data->forward);
+
+	if (!ipi_clusters_present)
+		return;
+
+	for (i = 0; i < BITS_TO_LONGS(SBI_HARTMASK_MAX_BITS); i++) {
+		sbi_hartmask_bits(&forward_mask)[i] = (bits[i]) ?
+				atomic_raw_xchg_ulong(&bits[i], 0) : 0;
+		if (sbi_hartmask_bits(&forward_mask)[i])
+			forward = true;
+	}
+
+	if (forward)
+		sbi_ipi_trigger_direct(&forward_mask);
+}
+
+/**
+ * Pass on the IPIs other HARTs of the cluster left with current HART.
+ *
+ * A source may pick current HART as leader just before it stops, so the
+ * stop and restart paths must call this instead of dropping the bits.
+ */
+void sbi_ipi_process_forward(void)
+{
+	ipi_process_forward(sbi_scratch_thishart_offset_ptr(ipi_data_off));
 }
 
 /**
  * As this this function only handlers scalar values of hart mask, it must be
  * set to all online harts if the intention is to send IPIs to all the harts.
  * If hmask is zero, no IPIs will be sent.
+ *
+ * The event data is first updated for every target HART, then the IPIs are
+ * triggered all at once (using the multicast operation of the IPI device if
+ * available) and finally the event is synchronized with every target HART.
  */
 int sbi_ipi_send_many(ulong hmask, ulong hbase, u32 event, void *data)
 {
 	int rc;
-	ulong i, m;
+	ulong m;
+	u32 i;
+	struct sbi_hartmask target_mask;
+	const struct sbi_ipi_event_ops *ipi_ops;
 	struct sbi_domain *dom = sbi_domain_thishart_ptr();
 	struct sbi_scratch *scratch = sbi_scratch_thishart_ptr();
 
+	if ((SBI_IPI_EVENT_MAX <= event) ||
+	    !ipi_ops_array[event])
+		return SBI_EINVAL;
+	ipi_ops = ipi_ops_array[event];
+
+	SBI_HARTMASK_INIT(&target_mask);
+
 	if (hbase != -1UL) {
 		rc = sbi_hsm_hart_interruptible_mask(dom, hbase, &m);
 		if (rc)
 			return rc;
 		m &= hmask;
 
-		/* Send IPIs */
-		for (i = hbase; m; i++, m >>= 1) {
-			if (m & 1UL)
-				sbi_ipi_send(scratch, i, event, data);
-		}
+		sbi_ipi_update_many(scratch, m, hbase, event, data,
+				    &target_mask);
 	} else {
 		hbase = 0;
 		while (!sbi_hsm_hart_interruptible_mask(dom, hbase, &m)) {
-			/* Send IPIs */
-			for (i = hbase; m; i++, m >>= 1) {
-				if (m & 1UL)
-					sbi_ipi_send(scratch, i, event, data);
-			}
+			sbi_ipi_update_many(scratch, m, hbase, event, data,
+					    &target_mask);
 			hbase += BITS_PER_LONG;
 		}
 	}
 
+	/* Trigger the interrupt on all target HARTs */
+	smp_wmb();
+	sbi_ipi_trigger(&target_mask);
+
+	sbi_hartmask_for_each_hart(i, &target_mask) {
+		sbi_pmu_ctr_incr_fw(SBI_PMU_FW_IPI_SENT);
+
+		if (ipi_ops->sync)
+			ipi_ops->sync(scratch);
+	}
+
 	return 0;
 }
 
@@ -192,6 +311,9 @@ void sbi_ipi_process(void)
 	if (ipi_dev && ipi_dev->ipi_clear)
 		ipi_dev->ipi_clear(hartid);
 
+	/* Wake up the rest of our cluster before handling the events */
+	ipi_process_forward(ipi_data);
+
 	ipi_type = atomic_raw_xchg_ulong(&ipi_data->ipi_type, 0);
 	ipi_event = 0;
 	while (ipi_type) {
@@ -217,6 +339,19 @@ int sbi_ipi_raw_send(u32 target_hart)
 	return 0;
 }
 
+int sbi_ipi_set_hart_cluster(u32 hartid, u32 cluster)
+{
+	if (SBI_HARTMASK_MAX_BITS <= hartid ||
+	    (SBI_IPI_CLUSTER_MAX <= cluster && cluster != SBI_IPI_CLUSTER_NONE))
+		return SBI_EINVAL;
+
+	ipi_hart_cluster[hartid] = cluster;
+	if (cluster != SBI_IPI_CLUSTER_NONE)
+		ipi_clusters_present = true;
+
+	return 0;
+}
+
 const struct sbi_ipi_device *sbi_ipi_get_device(void)
 {
 	return ipi_dev;
@@ -236,7 +371,8 @@ int sbi_ipi_init(struct sbi_scratch *scratch, bool cold_boot)
 	struct sbi_ipi_data *ipi_data;
 
 	if (cold_boot) {
-		ipi_data_off = sbi_scratch_alloc_offset(sizeof(*ipi_data));
+		ipi_data_off = sbi_scratch_alloc_aligned_offset("ipi",
+					sizeof(*ipi_data), SBI_CACHE_LINE_SIZE);
 		if (!ipi_data_off)
 			return SBI_ENOMEM;
 		ret = sbi_ipi_event_create(&ipi_smode_ops);
@@ -266,6 +402,12 @@ int sbi_ipi_init(struct sbi_scratch *scratch, bool cold_boot)
 	if (ret)
 		return ret;
 
+	/*
+	 * IPIs which other HARTs of the cluster left with us while we
+	 * were stopped are still owed to them.
+	 */
+	ipi_process_forward(ipi_data);
+
 	/* Enable software interrupts */
 	csr_set(CSR_MIE, MIP_MSIP);
 
@@ -134,14 +134,20 @@ int sbi_misaligned_load_handler(ulong addr, ulong tval2, ulong tinst,
 	}
 
 	val.data_u64 = 0;
-	for (i = 0; i < len; i++) {
-		val.data_bytes[i] = sbi_load_u8((void *)(addr + i),
-						&uptrap);
-		if (uptrap.cause) {
-			uptrap.epc = regs->mepc;
-			uptrap.tinst = sbi_misaligned_tinst_fixup(
-				tinst, uptrap.tinst, i);
-			return sbi_trap_redirect(regs, &uptrap);
+	if (len <= sizeof(ulong))
+		val.data_ulong = sbi_load_unaligned(addr, len, &uptrap);
+
+	/* Fall back to bytes to find the exact faulting address */
+	if (len > sizeof(ulong) || uptrap.cause) {
+		for (i = 0; i < len; i++) {
+			val.data_bytes[i] = sbi_load_u8((void *)(addr + i),
+							&uptrap);
+			if (uptrap.cause) {
+				uptrap.epc = regs->mepc;
+				uptrap.tinst = sbi_misaligned_tinst_fixup(
+					tinst, uptrap.tinst, i);
+				return sbi_trap_redirect(regs, &uptrap);
+			}
 		}
 	}
 
@@ -249,14 +255,20 @@ int sbi_misaligned_store_handler(ulong addr, ulong tval2, ulong tinst,
 		return sbi_trap_redirect(regs, &uptrap);
 	}
 
-	for (i = 0; i < len; i++) {
-		sbi_store_u8((void *)(addr + i), val.data_bytes[i],
-			     &uptrap);
-		if (uptrap.cause) {
-			uptrap.epc = regs->mepc;
-			uptrap.tinst = sbi_misaligned_tinst_fixup(
-				tinst, uptrap.tinst, i);
-			return sbi_trap_redirect(regs, &uptrap);
+	if (len <= sizeof(ulong))
+		sbi_store_unaligned(addr, val.data_ulong, len, &uptrap);
+
+	/* Fall back to bytes to find the exact faulting address */
+	if (len > sizeof(ulong) || uptrap.cause) {
+		for (i = 0; i < len; i++) {
+			sbi_store_u8((void *)(addr + i), val.data_bytes[i],
+				     &uptrap);
+			if (uptrap.cause) {
+				uptrap.epc = regs->mepc;
+				uptrap.tinst = sbi_misaligned_tinst_fixup(
+					tinst, uptrap.tinst, i);
+				return sbi_trap_redirect(regs, &uptrap);
+			}
 		}
 	}
 
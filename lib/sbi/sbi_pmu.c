@@ -10,6 +10,7 @@
 #include <sbi/riscv_asm.h>
 #include <sbi/sbi_bitops.h>
 #include <sbi/sbi_console.h>
+#include <sbi/sbi_domain.h>
 #include <sbi/sbi_ecall_interface.h>
 #include <sbi/sbi_hart.h>
 #include <sbi/sbi_hartmask.h>
@@ -17,6 +18,7 @@
 #include <sbi/sbi_pmu.h>
 #include <sbi/sbi_scratch.h>
 #include <sbi/sbi_string.h>
+#include <sbi/sbi_timer.h>
 
 /** Information about hardware counters */
 struct sbi_pmu_hw_event {
@@ -56,17 +58,41 @@ static const struct sbi_pmu_device *pmu_dev = NULL;
 /* Mapping between event range and possible counters  */
 static struct sbi_pmu_hw_event hw_event_map[SBI_PMU_HW_EVENT_MAX] = {0};
 
-/* counter to enabled event mapping */
-static uint32_t active_events[SBI_HARTMASK_MAX_BITS][SBI_PMU_HW_CTR_MAX + SBI_PMU_FW_CTR_MAX];
-
-/* Bitmap of firmware counters started on each HART */
 #if SBI_PMU_FW_CTR_MAX >= BITS_PER_LONG
 #error "Can't handle firmware counters beyond BITS_PER_LONG"
 #endif
-static unsigned long fw_counters_started[SBI_HARTMASK_MAX_BITS];
 
-/* Values of firmwares counters on each HART */
-static uint64_t fw_counters_value[SBI_HARTMASK_MAX_BITS][SBI_PMU_FW_CTR_MAX] = {0};
+/** Layout of the counter snapshot shared memory */
+struct sbi_pmu_snapshot {
+	/* Overflow status of counters relative to the counter base */
+	uint64_t ctr_overflow_mask;
+	/* Counter values relative to the counter base */
+	uint64_t ctr_values[64];
+	uint64_t reserved[447];
+};
+
+/** Per-HART state of the PMU counters */
+struct sbi_pmu_hart_state {
+	/* Counter to enabled event mapping */
+	uint32_t active_events[SBI_PMU_HW_CTR_MAX + SBI_PMU_FW_CTR_MAX];
+	/* Bitmap of firmware counters started */
+	unsigned long fw_counters_started;
+	/* Values of firmware counters */
+	uint64_t fw_counters_value[SBI_PMU_FW_CTR_MAX];
+	/* Started firmware counter tracking each SBI firmware event */
+	uint8_t fw_event_ctr[SBI_PMU_FW_MAX];
+	/* Counter snapshot shared memory set by S-mode, if any */
+	struct sbi_pmu_snapshot *snapshot;
+};
+
+/* No started firmware counter tracks the event */
+#define PMU_FW_EVENT_CTR_NONE	0xff
+
+/* Offset of PMU HART state in scratch space */
+static unsigned long phs_off;
+
+#define pmu_thishart_state_ptr()	\
+	((struct sbi_pmu_hart_state *)sbi_scratch_thishart_offset_ptr(phs_off))
 
 /* Maximum number of hardware events available */
 static uint32_t num_hw_events;
@@ -153,16 +179,42 @@ static int pmu_event_validate(unsigned long event_idx)
 	return SBI_EINVAL;
 }
 
+/**
+ * Refresh the firmware counter incremented for an SBI firmware event
+ *
+ * Called whenever a firmware counter is started or stopped so that
+ * sbi_pmu_ctr_incr_fw() does not have to search the counters. As before,
+ * the lowest started counter tracking the event wins.
+ */
+static void pmu_fw_event_map_update(struct sbi_pmu_hart_state *phs,
+				    uint32_t event_code)
+{
+	uint32_t i;
+
+	if (SBI_PMU_FW_MAX <= event_code)
+		return;
+
+	phs->fw_event_ctr[event_code] = PMU_FW_EVENT_CTR_NONE;
+	for (i = 0; i < SBI_PMU_FW_CTR_MAX; i++) {
+		if ((phs->fw_counters_started & BIT(i)) &&
+		    get_cidx_code(phs->active_events[num_hw_ctrs + i]) ==
+			    event_code) {
+			phs->fw_event_ctr[event_code] = i;
+			break;
+		}
+	}
+}
+
 static int pmu_ctr_validate(uint32_t cidx, uint32_t *event_idx_code)
 {
 	uint32_t event_idx_val;
 	uint32_t event_idx_type;
-	u32 hartid = current_hartid();
+	struct sbi_pmu_hart_state *phs = pmu_thishart_state_ptr();
 
 	if (cidx >= total_ctrs)
 		return SBI_EINVAL;
 
-	event_idx_val = active_events[hartid][cidx];
+	event_idx_val = phs->active_events[cidx];
 	event_idx_type = get_cidx_type(event_idx_val);
 	if (event_idx_val == SBI_PMU_EVENT_IDX_INVALID ||
 	    event_idx_type >= SBI_PMU_EVENT_TYPE_MAX)
@@ -177,7 +229,7 @@ int sbi_pmu_ctr_fw_read(uint32_t cidx, uint64_t *cval)
 {
 	int event_idx_type;
 	uint32_t event_code;
-	u32 hartid = current_hartid();
+	struct sbi_pmu_hart_state *phs = pmu_thishart_state_ptr();
 
 	event_idx_type = pmu_ctr_validate(cidx, &event_code);
 	if (event_idx_type != SBI_PMU_EVENT_TYPE_FW)
@@ -185,10 +237,10 @@ int sbi_pmu_ctr_fw_read(uint32_t cidx, uint64_t *cval)
 
 	if (SBI_PMU_FW_MAX <= event_code &&
 	    pmu_dev && pmu_dev->fw_counter_read_value)
-		fw_counters_value[hartid][cidx - num_hw_ctrs] =
+		phs->fw_counters_value[cidx - num_hw_ctrs] =
 			pmu_dev->fw_counter_read_value(cidx - num_hw_ctrs);
 
-	*cval = fw_counters_value[hartid][cidx - num_hw_ctrs];
+	*cval = phs->fw_counters_value[cidx - num_hw_ctrs];
 
 	return 0;
 }
@@ -300,6 +352,9 @@ static int pmu_ctr_enable_irq_hw(int ctr_idx)
 
 static void pmu_ctr_write_hw(uint32_t cidx, uint64_t ival)
 {
+	if (!cidx)
+		sbi_timer_fast_invalidate();
+
 #if __riscv_xlen == 32
 	csr_write_num(CSR_MCYCLE + cidx, 0);
 	csr_write_num(CSR_MCYCLE + cidx, ival & 0xFFFFFFFF);
@@ -309,6 +364,37 @@ static void pmu_ctr_write_hw(uint32_t cidx, uint64_t ival)
 #endif
 }
 
+static uint64_t pmu_ctr_read_hw(uint32_t cidx)
+{
+#if __riscv_xlen == 32
+	uint32_t lo, hi, tmp;
+
+	do {
+		hi  = csr_read_num(CSR_MCYCLEH + cidx);
+		lo  = csr_read_num(CSR_MCYCLE + cidx);
+		tmp = csr_read_num(CSR_MCYCLEH + cidx);
+	} while (hi != tmp);
+
+	return ((uint64_t)hi << 32) | lo;
+#else
+	return csr_read_num(CSR_MCYCLE + cidx);
+#endif
+}
+
+static bool pmu_ctr_overflow_hw(uint32_t cidx)
+{
+	if (cidx < 3 || cidx >= SBI_PMU_HW_CTR_MAX ||
+	    !sbi_hart_has_extension(sbi_scratch_thishart_ptr(),
+				    SBI_HART_EXT_SSCOFPMF))
+		return false;
+
+#if __riscv_xlen == 32
+	return csr_read_num(CSR_MHPMEVENT3H + cidx - 3) & MHPMEVENTH_OF;
+#else
+	return csr_read_num(CSR_MHPMEVENT3 + cidx - 3) & MHPMEVENT_OF;
+#endif
+}
+
 static int pmu_ctr_start_hw(uint32_t cidx, uint64_t ival, bool ival_update)
 {
 	struct sbi_scratch *scratch = sbi_scratch_thishart_ptr();
@@ -360,7 +446,7 @@ static int pmu_ctr_start_fw(uint32_t cidx, uint32_t event_code,
 			    uint64_t ival, bool ival_update)
 {
 	int ret;
-	u32 hartid = current_hartid();
+	struct sbi_pmu_hart_state *phs = pmu_thishart_state_ptr();
 
 	if (SBI_PMU_FW_MAX <= event_code &&
 	    pmu_dev && pmu_dev->fw_counter_start) {
@@ -372,8 +458,9 @@ static int pmu_ctr_start_fw(uint32_t cidx, uint32_t event_code,
 	}
 
 	if (ival_update)
-		fw_counters_value[hartid][cidx - num_hw_ctrs] = ival;
-	fw_counters_started[hartid] |= BIT(cidx - num_hw_ctrs);
+		phs->fw_counters_value[cidx - num_hw_ctrs] = ival;
+	phs->fw_counters_started |= BIT(cidx - num_hw_ctrs);
+	pmu_fw_event_map_update(phs, event_code);
 
 	return 0;
 }
@@ -383,6 +470,7 @@ int sbi_pmu_ctr_start(unsigned long cbase, unsigned long cmask,
 {
 	int event_idx_type;
 	uint32_t event_code;
+	struct sbi_pmu_hart_state *phs = pmu_thishart_state_ptr();
 	int ret = SBI_EINVAL;
 	bool bUpdate = false;
 	int i, cidx;
@@ -390,8 +478,13 @@ int sbi_pmu_ctr_start(unsigned long cbase, unsigned long cmask,
 	if ((cbase + sbi_fls(cmask)) >= total_ctrs)
 		return ret;
 
-	if (flags & SBI_PMU_START_FLAG_SET_INIT_VALUE)
+	if (flags & SBI_PMU_START_FLAG_INIT_SNAPSHOT) {
+		if (!phs->snapshot)
+			return SBI_ENO_SHMEM;
+		bUpdate = true;
+	} else if (flags & SBI_PMU_START_FLAG_SET_INIT_VALUE) {
 		bUpdate = true;
+	}
 
 	for_each_set_bit(i, &cmask, total_ctrs) {
 		cidx = i + cbase;
@@ -399,7 +492,11 @@ int sbi_pmu_ctr_start(unsigned long cbase, unsigned long cmask,
 		if (event_idx_type < 0)
 			/* Continue the start operation for other counters */
 			continue;
-		else if (event_idx_type == SBI_PMU_EVENT_TYPE_FW)
+
+		if (flags & SBI_PMU_START_FLAG_INIT_SNAPSHOT)
+			ival = phs->snapshot->ctr_values[i];
+
+		if (event_idx_type == SBI_PMU_EVENT_TYPE_FW)
 			ret = pmu_ctr_start_fw(cidx, event_code, ival, bUpdate);
 		else
 			ret = pmu_ctr_start_hw(cidx, ival, bUpdate);
@@ -432,6 +529,7 @@ static int pmu_ctr_stop_hw(uint32_t cidx)
 
 static int pmu_ctr_stop_fw(uint32_t cidx, uint32_t event_code)
 {
+	struct sbi_pmu_hart_state *phs = pmu_thishart_state_ptr();
 	int ret;
 
 	if (SBI_PMU_FW_MAX <= event_code &&
@@ -441,7 +539,8 @@ static int pmu_ctr_stop_fw(uint32_t cidx, uint32_t event_code)
 			return ret;
 	}
 
-	fw_counters_started[current_hartid()] &= ~BIT(cidx - num_hw_ctrs);
+	phs->fw_counters_started &= ~BIT(cidx - num_hw_ctrs);
+	pmu_fw_event_map_update(phs, event_code);
 
 	return 0;
 }
@@ -462,10 +561,34 @@ static int pmu_reset_hw_mhpmevent(int ctr_idx)
 	return 0;
 }
 
+/*
+ * Save a stopped counter into the snapshot shared memory so that S-mode
+ * gets the values of all counters it stopped without further ecalls.
+ */
+static void pmu_ctr_snapshot(struct sbi_pmu_hart_state *phs, int i,
+			     uint32_t cidx, int event_idx_type)
+{
+	struct sbi_pmu_snapshot *snap = phs->snapshot;
+	uint64_t val = 0;
+
+	if (event_idx_type == SBI_PMU_EVENT_TYPE_FW) {
+		sbi_pmu_ctr_fw_read(cidx, &val);
+		snap->ctr_overflow_mask &= ~(1ULL << i);
+	} else {
+		val = pmu_ctr_read_hw(cidx);
+		if (pmu_ctr_overflow_hw(cidx))
+			snap->ctr_overflow_mask |= (1ULL << i);
+		else
+			snap->ctr_overflow_mask &= ~(1ULL << i);
+	}
+
+	snap->ctr_values[i] = val;
+}
+
 int sbi_pmu_ctr_stop(unsigned long cbase, unsigned long cmask,
 		     unsigned long flag)
 {
-	u32 hartid = current_hartid();
+	struct sbi_pmu_hart_state *phs = pmu_thishart_state_ptr();
 	int ret = SBI_EINVAL;
 	int event_idx_type;
 	uint32_t event_code;
@@ -474,6 +597,9 @@ int sbi_pmu_ctr_stop(unsigned long cbase, unsigned long cmask,
 	if ((cbase + sbi_fls(cmask)) >= total_ctrs)
 		return SBI_EINVAL;
 
+	if ((flag & SBI_PMU_STOP_FLAG_TAKE_SNAPSHOT) && !phs->snapshot)
+		return SBI_ENO_SHMEM;
+
 	for_each_set_bit(i, &cmask, total_ctrs) {
 		cidx = i + cbase;
 		event_idx_type = pmu_ctr_validate(cidx, &event_code);
@@ -486,8 +612,11 @@ int sbi_pmu_ctr_stop(unsigned long cbase, unsigned long cmask,
 		else
 			ret = pmu_ctr_stop_hw(cidx);
 
+		if (flag & SBI_PMU_STOP_FLAG_TAKE_SNAPSHOT)
+			pmu_ctr_snapshot(phs, i, cidx, event_idx_type);
+
 		if (flag & SBI_PMU_STOP_FLAG_RESET) {
-			active_events[hartid][cidx] = SBI_PMU_EVENT_IDX_INVALID;
+			phs->active_events[cidx] = SBI_PMU_EVENT_IDX_INVALID;
 			pmu_reset_hw_mhpmevent(cidx);
 		}
 	}
@@ -565,7 +694,7 @@ static int pmu_ctr_find_hw(unsigned long cbase, unsigned long cmask, unsigned lo
 	int i, ret = 0, fixed_ctr, ctr_idx = SBI_ENOTSUPP;
 	struct sbi_pmu_hw_event *temp;
 	unsigned long mctr_inhbt = 0;
-	u32 hartid = current_hartid();
+	struct sbi_pmu_hart_state *phs = pmu_thishart_state_ptr();
 	struct sbi_scratch *scratch = sbi_scratch_thishart_ptr();
 
 	if (cbase >= num_hw_ctrs)
@@ -604,7 +733,7 @@ static int pmu_ctr_find_hw(unsigned long cbase, unsigned long cmask, unsigned lo
 			 * Some of the platform may not support mcountinhibit.
 			 * Checking the active_events is enough for them
 			 */
-			if (active_events[hartid][cbase] != SBI_PMU_EVENT_IDX_INVALID)
+			if (phs->active_events[cbase] != SBI_PMU_EVENT_IDX_INVALID)
 				continue;
 			/* If mcountinhibit is supported, the bit must be enabled */
 			if ((sbi_hart_priv_version(scratch) >= SBI_HART_PRIV_VER_1_11) &&
@@ -640,7 +769,8 @@ static int pmu_ctr_find_hw(unsigned long cbase, unsigned long cmask, unsigned lo
  * check.
  */
 static int pmu_ctr_find_fw(unsigned long cbase, unsigned long cmask,
-			   uint32_t event_code, u32 hartid)
+			   uint32_t event_code,
+			   struct sbi_pmu_hart_state *phs)
 {
 	int i, cidx;
 
@@ -648,7 +778,7 @@ static int pmu_ctr_find_fw(unsigned long cbase, unsigned long cmask,
 		cidx = i + cbase;
 		if (cidx < num_hw_ctrs || total_ctrs <= cidx)
 			continue;
-		if (active_events[hartid][i] != SBI_PMU_EVENT_IDX_INVALID)
+		if (phs->active_events[i] != SBI_PMU_EVENT_IDX_INVALID)
 			continue;
 		if (SBI_PMU_FW_MAX <= event_code &&
 		    pmu_dev && pmu_dev->fw_counter_match_code) {
@@ -668,7 +798,8 @@ int sbi_pmu_ctr_cfg_match(unsigned long cidx_base, unsigned long cidx_mask,
 			  uint64_t event_data)
 {
 	int ret, ctr_idx = SBI_ENOTSUPP;
-	u32 event_code, hartid = current_hartid();
+	struct sbi_pmu_hart_state *phs = pmu_thishart_state_ptr();
+	u32 event_code;
 	int event_type;
 
 	/* Do a basic sanity check of counter base & mask */
@@ -685,7 +816,7 @@ int sbi_pmu_ctr_cfg_match(unsigned long cidx_base, unsigned long cidx_mask,
 		 * counter idx for the given event. Verify that the counter idx
 		 * is still valid.
 		 */
-		if (active_events[hartid][cidx_base] == SBI_PMU_EVENT_IDX_INVALID)
+		if (phs->active_events[cidx_base] == SBI_PMU_EVENT_IDX_INVALID)
 			return SBI_EINVAL;
 		ctr_idx = cidx_base;
 		goto skip_match;
@@ -693,7 +824,7 @@ int sbi_pmu_ctr_cfg_match(unsigned long cidx_base, unsigned long cidx_mask,
 
 	if (event_type == SBI_PMU_EVENT_TYPE_FW) {
 		/* Any firmware counter can be used track any firmware event */
-		ctr_idx = pmu_ctr_find_fw(cidx_base, cidx_mask, event_code, hartid);
+		ctr_idx = pmu_ctr_find_fw(cidx_base, cidx_mask, event_code, phs);
 	} else {
 		ctr_idx = pmu_ctr_find_hw(cidx_base, cidx_mask, flags, event_idx,
 					  event_data);
@@ -702,7 +833,7 @@ int sbi_pmu_ctr_cfg_match(unsigned long cidx_base, unsigned long cidx_mask,
 	if (ctr_idx < 0)
 		return SBI_ENOTSUPP;
 
-	active_events[hartid][ctr_idx] = event_idx;
+	phs->active_events[ctr_idx] = event_idx;
 skip_match:
 	if (event_type == SBI_PMU_EVENT_TYPE_HW) {
 		if (flags & SBI_PMU_CFG_FLAG_CLEAR_VALUE)
@@ -711,18 +842,19 @@ skip_match:
 			pmu_ctr_start_hw(ctr_idx, 0, false);
 	} else if (event_type == SBI_PMU_EVENT_TYPE_FW) {
 		if (flags & SBI_PMU_CFG_FLAG_CLEAR_VALUE)
-			fw_counters_value[hartid][ctr_idx - num_hw_ctrs] = 0;
+			phs->fw_counters_value[ctr_idx - num_hw_ctrs] = 0;
 		if (flags & SBI_PMU_CFG_FLAG_AUTO_START) {
 			if (SBI_PMU_FW_MAX <= event_code &&
 			    pmu_dev && pmu_dev->fw_counter_start) {
 				ret = pmu_dev->fw_counter_start(
 					ctr_idx - num_hw_ctrs, event_code,
-					fw_counters_value[hartid][ctr_idx - num_hw_ctrs],
+					phs->fw_counters_value[ctr_idx - num_hw_ctrs],
 					true);
 				if (ret)
 					return ret;
 			}
-			fw_counters_started[hartid] |= BIT(ctr_idx - num_hw_ctrs);
+			phs->fw_counters_started |= BIT(ctr_idx - num_hw_ctrs);
+			pmu_fw_event_map_update(phs, event_code);
 		}
 	}
 
@@ -731,25 +863,22 @@ skip_match:
 
 int sbi_pmu_ctr_incr_fw(enum sbi_pmu_fw_event_code_id fw_id)
 {
-	u32 cidx, hartid = current_hartid();
-	uint64_t *fcounter = NULL;
+	struct sbi_pmu_hart_state *phs;
+	uint8_t fidx;
 
-	if (likely(!fw_counters_started[hartid]))
+	/* May be called from IPI and trap paths before the PMU is set up */
+	if (unlikely(!phs_off))
 		return 0;
 
 	if (unlikely(fw_id >= SBI_PMU_FW_MAX))
 		return SBI_EINVAL;
 
-	for (cidx = num_hw_ctrs; cidx < total_ctrs; cidx++) {
-		if (get_cidx_code(active_events[hartid][cidx]) == fw_id &&
-		    (fw_counters_started[hartid] & BIT(cidx - num_hw_ctrs))) {
-			fcounter = &fw_counters_value[hartid][cidx - num_hw_ctrs];
-			break;
-		}
-	}
+	phs = pmu_thishart_state_ptr();
+	fidx = phs->fw_event_ctr[fw_id];
+	if (likely(fidx == PMU_FW_EVENT_CTR_NONE))
+		return 0;
 
-	if (fcounter)
-		(*fcounter)++;
+	phs->fw_counters_value[fidx]++;
 
 	return 0;
 }
@@ -789,16 +918,45 @@ int sbi_pmu_ctr_get_info(uint32_t cidx, unsigned long *ctr_info)
 	return 0;
 }
 
-static void pmu_reset_event_map(u32 hartid)
+int sbi_pmu_snapshot_set_shmem(unsigned long shmem_lo,
+			       unsigned long shmem_hi, unsigned long flags)
+{
+	struct sbi_pmu_hart_state *phs = pmu_thishart_state_ptr();
+
+	if (flags)
+		return SBI_EINVAL;
+
+	if (shmem_lo == -1UL && shmem_hi == -1UL) {
+		phs->snapshot = NULL;
+		return 0;
+	}
+
+	if (shmem_lo & (SBI_PMU_SNAPSHOT_SIZE - 1))
+		return SBI_EINVAL;
+
+	if (!sbi_domain_check_shmem(shmem_lo, shmem_hi, SBI_PMU_SNAPSHOT_SIZE,
+				    SBI_DOMAIN_READ | SBI_DOMAIN_WRITE))
+		return SBI_EINVALID_ADDR;
+
+	phs->snapshot = (struct sbi_pmu_snapshot *)shmem_lo;
+	sbi_memset(phs->snapshot, 0, sizeof(*phs->snapshot));
+
+	return 0;
+}
+
+static void pmu_reset_event_map(struct sbi_pmu_hart_state *phs)
 {
 	int j;
 
 	/* Initialize the counter to event mapping table */
 	for (j = 3; j < total_ctrs; j++)
-		active_events[hartid][j] = SBI_PMU_EVENT_IDX_INVALID;
+		phs->active_events[j] = SBI_PMU_EVENT_IDX_INVALID;
 	for (j = 0; j < SBI_PMU_FW_CTR_MAX; j++)
-		fw_counters_value[hartid][j] = 0;
-	fw_counters_started[hartid] = 0;
+		phs->fw_counters_value[j] = 0;
+	phs->fw_counters_started = 0;
+	sbi_memset(phs->fw_event_ctr, PMU_FW_EVENT_CTR_NONE,
+		   sizeof(phs->fw_event_ctr));
+	phs->snapshot = NULL;
 }
 
 const struct sbi_pmu_device *sbi_pmu_get_device(void)
@@ -816,22 +974,25 @@ void sbi_pmu_set_device(const struct sbi_pmu_device *dev)
 
 void sbi_pmu_exit(struct sbi_scratch *scratch)
 {
-	u32 hartid = current_hartid();
-
 	if (sbi_hart_priv_version(scratch) >= SBI_HART_PRIV_VER_1_11)
 		csr_write(CSR_MCOUNTINHIBIT, 0xFFFFFFF8);
 
 	if (sbi_hart_priv_version(scratch) >= SBI_HART_PRIV_VER_1_10)
 		csr_write(CSR_MCOUNTEREN, -1);
-	pmu_reset_event_map(hartid);
+	pmu_reset_event_map(sbi_scratch_offset_ptr(scratch, phs_off));
 }
 
 int sbi_pmu_init(struct sbi_scratch *scratch, bool cold_boot)
 {
 	const struct sbi_platform *plat;
-	u32 hartid = current_hartid();
+	struct sbi_pmu_hart_state *phs;
 
 	if (cold_boot) {
+		phs_off = sbi_scratch_alloc_aligned_offset("pmu", sizeof(*phs),
+							   __SIZEOF_POINTER__);
+		if (!phs_off)
+			return SBI_ENOMEM;
+
 		plat = sbi_platform_ptr(scratch);
 		/* Initialize hw pmu events */
 		sbi_platform_pmu_init(plat);
@@ -841,14 +1002,18 @@ int sbi_pmu_init(struct sbi_scratch *scratch, bool cold_boot)
 		total_ctrs = num_hw_ctrs + SBI_PMU_FW_CTR_MAX;
 	}
 
-	pmu_reset_event_map(hartid);
+	if (!phs_off)
+		return SBI_ENOMEM;
+
+	phs = sbi_scratch_offset_ptr(scratch, phs_off);
+	pmu_reset_event_map(phs);
 
 	/* First three counters are fixed by the priv spec and we enable it by default */
-	active_events[hartid][0] = SBI_PMU_EVENT_TYPE_HW << SBI_PMU_EVENT_IDX_OFFSET |
-				   SBI_PMU_HW_CPU_CYCLES;
-	active_events[hartid][1] = SBI_PMU_EVENT_IDX_INVALID;
-	active_events[hartid][2] = SBI_PMU_EVENT_TYPE_HW << SBI_PMU_EVENT_IDX_OFFSET |
-				   SBI_PMU_HW_INSTRUCTIONS;
+	phs->active_events[0] = SBI_PMU_EVENT_TYPE_HW << SBI_PMU_EVENT_IDX_OFFSET |
+				SBI_PMU_HW_CPU_CYCLES;
+	phs->active_events[1] = SBI_PMU_EVENT_IDX_INVALID;
+	phs->active_events[2] = SBI_PMU_EVENT_TYPE_HW << SBI_PMU_EVENT_IDX_OFFSET |
+				SBI_PMU_HW_INSTRUCTIONS;
 
 	return 0;
 }
@@ -8,6 +8,7 @@
  */
 
 #include <sbi/riscv_locks.h>
+#include <sbi/sbi_console.h>
 #include <sbi/sbi_hart.h>
 #include <sbi/sbi_hartmask.h>
 #include <sbi/sbi_platform.h>
@@ -17,8 +18,17 @@
 u32 last_hartid_having_scratch = SBI_HARTMASK_MAX_BITS - 1;
 struct sbi_scratch *hartid_to_scratch_table[SBI_HARTMASK_MAX_BITS] = { 0 };
 
+/** Book-keeping of one allocation from the extra space */
+struct sbi_scratch_alloc {
+	const char *owner;
+	unsigned long offset;
+	unsigned long size;
+};
+
 static spinlock_t extra_lock = SPIN_LOCK_INITIALIZER;
 static unsigned long extra_offset = SBI_SCRATCH_EXTRA_SPACE_OFFSET;
+static struct sbi_scratch_alloc extra_allocs[SBI_SCRATCH_ALLOC_MAX];
+static u32 extra_alloc_count;
 
 typedef struct sbi_scratch *(*hartid2scratch)(ulong hartid, ulong hartindex);
 
@@ -40,35 +50,48 @@ int sbi_scratch_init(struct sbi_scratch *scratch)
 	return 0;
 }
 
-unsigned long sbi_scratch_alloc_offset(unsigned long size)
+unsigned long sbi_scratch_alloc_aligned_offset(const char *owner,
+					       unsigned long size,
+					       unsigned long align)
 {
 	u32 i;
 	void *ptr;
 	unsigned long ret = 0;
 	struct sbi_scratch *rscratch;
+	struct sbi_scratch_alloc *alloc;
 
 	/*
-	 * We have a simple brain-dead allocator which never expects
-	 * anything to be free-ed hence it keeps incrementing the
-	 * next allocation offset until it runs-out of space.
-	 *
-	 * In future, we will have more sophisticated allocator which
-	 * will allow us to re-claim free-ed space.
+	 * This is a bump allocator. Each allocation is recorded with
+	 * its owner so that the usage can be dumped at boot, and the
+	 * most recent allocation can be released again which is all
+	 * the error paths of the init functions need.
 	 */
 
-	if (!size)
+	if (!size || !align || (align & (align - 1)))
 		return 0;
 
-	if (size & (__SIZEOF_POINTER__ - 1))
-		size = (size & ~(__SIZEOF_POINTER__ - 1)) + __SIZEOF_POINTER__;
+	if (align < __SIZEOF_POINTER__)
+		align = __SIZEOF_POINTER__;
+
+	/* Pad the size as well so the next allocation starts aligned */
+	size = ROUNDUP(size, align);
 
 	spin_lock(&extra_lock);
 
-	if (SBI_SCRATCH_SIZE < (extra_offset + size))
+	if (extra_alloc_count >= SBI_SCRATCH_ALLOC_MAX)
 		goto done;
 
-	ret = extra_offset;
-	extra_offset += size;
+	ret = ROUNDUP(extra_offset, align);
+	if (SBI_SCRATCH_SIZE < (ret + size)) {
+		ret = 0;
+		goto done;
+	}
+
+	alloc = &extra_allocs[extra_alloc_count++];
+	alloc->owner = owner ? owner : "unknown";
+	alloc->offset = ret;
+	alloc->size = size;
+	extra_offset = ret + size;
 
 done:
 	spin_unlock(&extra_lock);
@@ -86,14 +109,64 @@ done:
 	return ret;
 }
 
+unsigned long sbi_scratch_alloc_offset(unsigned long size)
+{
+	return sbi_scratch_alloc_aligned_offset(NULL, size,
+						__SIZEOF_POINTER__);
+}
+
 void sbi_scratch_free_offset(unsigned long offset)
 {
+	struct sbi_scratch_alloc *alloc;
+
 	if ((offset < SBI_SCRATCH_EXTRA_SPACE_OFFSET) ||
 	    (SBI_SCRATCH_SIZE <= offset))
 		return;
 
 	/*
-	 * We don't actually free-up because it's a simple
-	 * brain-dead allocator.
+	 * Only the most recent allocation is given back, anything
+	 * else stays allocated until reboot.
 	 */
+	spin_lock(&extra_lock);
+
+	if (extra_alloc_count) {
+		alloc = &extra_allocs[extra_alloc_count - 1];
+		if (alloc->offset == offset) {
+			extra_offset = (extra_alloc_count > 1) ?
+				       alloc[-1].offset + alloc[-1].size :
+				       SBI_SCRATCH_EXTRA_SPACE_OFFSET;
+			extra_alloc_count--;
+		}
+	}
+
+	spin_unlock(&extra_lock);
+}
+
+unsigned long sbi_scratch_used_space(void)
+{
+	unsigned long ret;
+
+	spin_lock(&extra_lock);
+	ret = extra_offset - SBI_SCRATCH_EXTRA_SPACE_OFFSET;
+	spin_unlock(&extra_lock);
+
+	return ret;
+}
+
+void sbi_scratch_dump(const char *suffix)
+{
+	u32 i;
+	struct sbi_scratch_alloc *alloc;
+
+	sbi_printf("Scratch Extra Space %s: %lu of %lu bytes used\n",
+		   suffix, sbi_scratch_used_space(),
+		   (unsigned long)SBI_SCRATCH_EXTRA_SPACE_SIZE);
+
+	spin_lock(&extra_lock);
+	for (i = 0; i < extra_alloc_count; i++) {
+		alloc = &extra_allocs[i];
+		sbi_printf("Scratch Alloc 0x%03lx %s: %-14s (%lu bytes)\n",
+			   alloc->offset, suffix, alloc->owner, alloc->size);
+	}
+	spin_unlock(&extra_lock);
 }
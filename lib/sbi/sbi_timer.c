@@ -16,10 +16,22 @@
 #include <sbi/sbi_platform.h>
 #include <sbi/sbi_pmu.h>
 #include <sbi/sbi_scratch.h>
+#include <sbi/sbi_string.h>
 #include <sbi/sbi_timer.h>
 #include <sbi/sbi_hext.h>
 
+/** Per-HART timer events ordered as a binary min-heap on deadline */
+struct timer_queue {
+	/** Built-in event carrying the S-mode deadline */
+	struct sbi_timer_event smode;
+	/** Number of queued events */
+	u32 count;
+	/** Queued events, heap[0] has the earliest deadline */
+	struct sbi_timer_event *heap[SBI_TIMER_EVENT_MAX];
+};
+
 static unsigned long time_delta_off;
+static unsigned long timer_queue_off;
 static u64 (*get_time_val)(void);
 static const struct sbi_timer_device *timer_dev = NULL;
 
@@ -97,6 +109,189 @@ u64 sbi_timer_value(void)
 	return 0;
 }
 
+#ifdef CONFIG_SBI_TIMER_FAST_TIME
+
+/* Longest stretch of mcycle trusted without reading the timer device */
+#define TIMER_FAST_PERIOD_MS		10
+
+/* Shortest window used for the first calibration */
+#define TIMER_FAST_CALIB_MIN_TICKS	16
+
+/** Per-HART mcycle to timer ticks conversion */
+struct timer_fast {
+	/** Timer value and mcycle of the last re-anchor */
+	u64 anchor_time;
+	u64 anchor_cycle;
+	/** Start of the window used to refine the scale */
+	u64 calib_time;
+	u64 calib_cycle;
+	/** Largest value handed out so far */
+	u64 last;
+	/** Timer ticks per cycle as 32.32 fixed point */
+	u64 mult;
+	/** Cycles after which the anchor is stale */
+	u64 max_cycles;
+	bool anchored;
+	bool calib_valid;
+	/** mcycle can be stopped through mcountinhibit */
+	bool check_inhibit;
+};
+
+static unsigned long timer_fast_off;
+
+static u64 timer_fast_cycles(void)
+{
+#if __riscv_xlen == 32
+	u32 lo, hi, tmp;
+
+	do {
+		hi  = csr_read(CSR_MCYCLEH);
+		lo  = csr_read(CSR_MCYCLE);
+		tmp = csr_read(CSR_MCYCLEH);
+	} while (hi != tmp);
+
+	return ((u64)hi << 32) | lo;
+#else
+	return csr_read(CSR_MCYCLE);
+#endif
+}
+
+static void timer_fast_set_mult(struct timer_fast *tf, u64 dtime, u64 dcycle)
+{
+	u64 period = timer_dev->timer_freq / (1000 / TIMER_FAST_PERIOD_MS);
+
+	if (!dtime || !dcycle)
+		return;
+
+	tf->mult = (dtime << 32) / dcycle;
+	if (!tf->mult)
+		tf->mult = 1;
+	tf->max_cycles = (period << 32) / tf->mult;
+}
+
+static void timer_fast_anchor(struct timer_fast *tf)
+{
+	u64 time = get_time_val();
+	u64 cycle = timer_fast_cycles();
+
+	/*
+	 * Refine the scale over the whole window since the last
+	 * disturbance so that the error shrinks as the HART runs. Restart
+	 * the window before the fixed point shift can overflow.
+	 */
+	if (tf->calib_valid && time - tf->calib_time < (1ULL << 31) &&
+	    cycle > tf->calib_cycle) {
+		timer_fast_set_mult(tf, time - tf->calib_time,
+				    cycle - tf->calib_cycle);
+	} else {
+		tf->calib_time = time;
+		tf->calib_cycle = cycle;
+		tf->calib_valid = true;
+	}
+
+	tf->anchor_time = time;
+	tf->anchor_cycle = cycle;
+	tf->anchored = true;
+}
+
+static void timer_fast_calibrate(struct sbi_scratch *scratch)
+{
+	struct timer_fast *tf = sbi_scratch_offset_ptr(scratch,
+						       timer_fast_off);
+	u64 window, time, cycle;
+
+	sbi_memset(tf, 0, sizeof(*tf));
+	tf->check_inhibit =
+		sbi_hart_priv_version(scratch) >= SBI_HART_PRIV_VER_1_11;
+	if (!timer_dev || !get_time_val || !timer_dev->timer_freq)
+		return;
+
+	window = timer_dev->timer_freq / 10000;
+	if (window < TIMER_FAST_CALIB_MIN_TICKS)
+		window = TIMER_FAST_CALIB_MIN_TICKS;
+
+	time = get_time_val();
+	cycle = timer_fast_cycles();
+	while (get_time_val() - time < window)
+		cpu_relax();
+
+	tf->calib_time = time;
+	tf->calib_cycle = cycle;
+	tf->calib_valid = true;
+	timer_fast_anchor(tf);
+	tf->last = tf->anchor_time;
+}
+
+u64 sbi_timer_fast_value(void)
+{
+	struct timer_fast *tf = sbi_scratch_offset_ptr(sbi_scratch_thishart_ptr(),
+						       timer_fast_off);
+	u64 delta, val;
+
+	/* The PMU extension lets S-mode stop mcycle */
+	if (!tf->mult ||
+	    (tf->check_inhibit && (csr_read(CSR_MCOUNTINHIBIT) & 0x1))) {
+		tf->anchored = false;
+		tf->calib_valid = false;
+		val = sbi_timer_value();
+		goto done;
+	}
+
+	/* A stale or backwards moving mcycle falls back to the device */
+	delta = timer_fast_cycles() - tf->anchor_cycle;
+	if (!tf->anchored || delta > tf->max_cycles) {
+		timer_fast_anchor(tf);
+		delta = 0;
+	}
+
+	val = tf->anchor_time + ((delta * tf->mult) >> 32);
+done:
+	if (val < tf->last)
+		val = tf->last;
+	tf->last = val;
+
+	return val;
+}
+
+void sbi_timer_fast_invalidate(void)
+{
+	struct timer_fast *tf;
+
+	if (!timer_fast_off)
+		return;
+
+	tf = sbi_scratch_offset_ptr(sbi_scratch_thishart_ptr(),
+				    timer_fast_off);
+	tf->anchored = false;
+	tf->calib_valid = false;
+}
+
+static int timer_fast_init(struct sbi_scratch *scratch, bool cold_boot)
+{
+	if (cold_boot) {
+		timer_fast_off = sbi_scratch_alloc_aligned_offset("timer_fast",
+					sizeof(struct timer_fast),
+					__SIZEOF_POINTER__);
+		if (!timer_fast_off)
+			return SBI_ENOMEM;
+	} else if (!timer_fast_off) {
+		return SBI_ENOMEM;
+	}
+
+	timer_fast_calibrate(scratch);
+
+	return 0;
+}
+
+#else
+
+static int timer_fast_init(struct sbi_scratch *scratch, bool cold_boot)
+{
+	return 0;
+}
+
+#endif
+
 u64 sbi_timer_virt_value(void)
 {
 	u64 *time_delta = sbi_scratch_offset_ptr(sbi_scratch_thishart_ptr(),
@@ -130,8 +325,163 @@ void sbi_timer_set_delta_upper(ulong delta_upper)
 	*time_delta |= ((u64)delta_upper << 32);
 }
 
+static void timer_queue_set(struct timer_queue *q, u32 pos,
+			    struct sbi_timer_event *ev)
+{
+	q->heap[pos] = ev;
+	ev->queue_pos = pos + 1;
+}
+
+static void timer_queue_sift_up(struct timer_queue *q, u32 pos)
+{
+	struct sbi_timer_event *ev = q->heap[pos];
+	u32 parent;
+
+	while (pos) {
+		parent = (pos - 1) / 2;
+		if (q->heap[parent]->deadline <= ev->deadline)
+			break;
+		timer_queue_set(q, pos, q->heap[parent]);
+		pos = parent;
+	}
+	timer_queue_set(q, pos, ev);
+}
+
+static void timer_queue_sift_down(struct timer_queue *q, u32 pos)
+{
+	struct sbi_timer_event *ev = q->heap[pos];
+	u32 child;
+
+	while ((child = 2 * pos + 1) < q->count) {
+		if (child + 1 < q->count &&
+		    q->heap[child + 1]->deadline < q->heap[child]->deadline)
+			child++;
+		if (ev->deadline <= q->heap[child]->deadline)
+			break;
+		timer_queue_set(q, pos, q->heap[child]);
+		pos = child;
+	}
+	timer_queue_set(q, pos, ev);
+}
+
+static void timer_queue_delete(struct timer_queue *q,
+			       struct sbi_timer_event *ev)
+{
+	struct sbi_timer_event *last = q->heap[--q->count];
+	u32 pos = ev->queue_pos - 1;
+
+	ev->queue_pos = 0;
+	if (last == ev)
+		return;
+
+	q->heap[pos] = last;
+	timer_queue_sift_up(q, pos);
+	timer_queue_sift_down(q, last->queue_pos - 1);
+}
+
+static void timer_queue_reset(struct timer_queue *q)
+{
+	while (q->count)
+		q->heap[--q->count]->queue_pos = 0;
+}
+
+static void timer_queue_program(struct timer_queue *q)
+{
+	if (!q->count) {
+		csr_clear(CSR_MIE, MIP_MTIP);
+		return;
+	}
+
+	if (timer_dev && timer_dev->timer_event_start)
+		timer_dev->timer_event_start(q->heap[0]->deadline);
+	csr_set(CSR_MIE, MIP_MTIP);
+}
+
+/*
+ * Touch the timer device only when the earliest deadline changes so
+ * that queueing a later event does not cost an extra MMIO write.
+ */
+static void timer_queue_update(struct timer_queue *q, u32 old_count,
+			       u64 old_deadline)
+{
+	if (old_count && q->count && q->heap[0]->deadline == old_deadline)
+		return;
+
+	timer_queue_program(q);
+}
+
+static void timer_queue_add(struct timer_queue *q,
+			    struct sbi_timer_event *ev, u64 deadline)
+{
+	u32 old_count = q->count;
+	u64 old_deadline = old_count ? q->heap[0]->deadline : 0;
+
+	ev->deadline = deadline;
+	if (ev->queue_pos) {
+		timer_queue_sift_up(q, ev->queue_pos - 1);
+		timer_queue_sift_down(q, ev->queue_pos - 1);
+	} else {
+		q->heap[q->count++] = ev;
+		timer_queue_sift_up(q, q->count - 1);
+	}
+
+	timer_queue_update(q, old_count, old_deadline);
+}
+
+static struct timer_queue *timer_queue_thishart(void)
+{
+	return sbi_scratch_offset_ptr(sbi_scratch_thishart_ptr(),
+				      timer_queue_off);
+}
+
+static void timer_smode_expired(struct sbi_timer_event *ev)
+{
+	struct hext_state *hext = sbi_hext_current_state();
+
+	if (hext->virt)
+		hext->sip |= SIP_STIP;
+	else
+		csr_set(CSR_MIP, MIP_STIP);
+}
+
+int sbi_timer_event_add(struct sbi_timer_event *ev, u64 deadline)
+{
+	struct timer_queue *q;
+
+	if (!ev || !ev->handler)
+		return SBI_EINVAL;
+	if (!timer_queue_off)
+		return SBI_ENODEV;
+
+	q = timer_queue_thishart();
+	if (!ev->queue_pos && q->count >= SBI_TIMER_EVENT_MAX)
+		return SBI_ENOSPC;
+
+	timer_queue_add(q, ev, deadline);
+
+	return 0;
+}
+
+void sbi_timer_event_remove(struct sbi_timer_event *ev)
+{
+	struct timer_queue *q;
+	u32 old_count;
+	u64 old_deadline;
+
+	if (!ev || !ev->queue_pos || !timer_queue_off)
+		return;
+
+	q = timer_queue_thishart();
+	old_count = q->count;
+	old_deadline = q->heap[0]->deadline;
+	timer_queue_delete(q, ev);
+	timer_queue_update(q, old_count, old_deadline);
+}
+
 void sbi_timer_event_start(u64 next_event)
 {
+	struct timer_queue *q;
+
 	sbi_pmu_ctr_incr_fw(SBI_PMU_FW_SET_TIMER);
 
 	/**
@@ -145,32 +495,42 @@ void sbi_timer_event_start(u64 next_event)
 #else
 		csr_write(CSR_STIMECMP, next_event);
 #endif
-	} else if (timer_dev && timer_dev->timer_event_start) {
-		timer_dev->timer_event_start(next_event);
-		csr_clear(CSR_MIP, MIP_STIP);
+		return;
 	}
-	csr_set(CSR_MIE, MIP_MTIP);
+
+	/*
+	 * Without sstc the S-mode deadline shares the M-mode timer with
+	 * the other events of this HART so it goes through the queue.
+	 */
+	csr_clear(CSR_MIP, MIP_STIP);
+	q = timer_queue_thishart();
+	timer_queue_add(q, &q->smode, next_event);
 }
 
 void sbi_timer_process(void)
 {
-	struct hext_state *hext = sbi_hext_current_state();
+	struct timer_queue *q = timer_queue_thishart();
+	struct sbi_timer_event *ev;
+	u64 now;
 
 	csr_clear(CSR_MIE, MIP_MTIP);
+	if (!q->count)
+		return;
+
 	/*
-	 * If sstc extension is available, supervisor can receive the timer
-	 * directly without M-mode come in between. This function should
-	 * only invoked if M-mode programs the timer for its own purpose.
+	 * Without a readable time source trust the interrupt and only
+	 * expire the event which programmed it.
 	 */
-	if (!sbi_hart_has_extension(sbi_scratch_thishart_ptr(),
-				    SBI_HART_EXT_SSTC)) {
-		// sbi_printf("%s: MTI V=%d\n", __func__, hext->virt);
-
-		if (hext->virt)
-			hext->sip |= SIP_STIP;
-		else
-			csr_set(CSR_MIP, MIP_STIP);
+	now = get_time_val ? get_time_val() : q->heap[0]->deadline;
+	while (q->count) {
+		ev = q->heap[0];
+		if (now < ev->deadline)
+			break;
+		timer_queue_delete(q, ev);
+		ev->handler(ev);
 	}
+
+	timer_queue_program(q);
 }
 
 const struct sbi_timer_device *sbi_timer_get_device(void)
@@ -190,25 +550,44 @@ void sbi_timer_set_device(const struct sbi_timer_device *dev)
 
 int sbi_timer_init(struct sbi_scratch *scratch, bool cold_boot)
 {
+	struct timer_queue *q;
 	u64 *time_delta;
+	int rc;
 	const struct sbi_platform *plat = sbi_platform_ptr(scratch);
 
 	if (cold_boot) {
-		time_delta_off = sbi_scratch_alloc_offset(sizeof(*time_delta));
+		time_delta_off = sbi_scratch_alloc_aligned_offset("timer",
+					sizeof(*time_delta), __SIZEOF_POINTER__);
 		if (!time_delta_off)
 			return SBI_ENOMEM;
 
+		timer_queue_off = sbi_scratch_alloc_aligned_offset("timer_queue",
+					sizeof(*q), __SIZEOF_POINTER__);
+		if (!timer_queue_off) {
+			sbi_scratch_free_offset(time_delta_off);
+			time_delta_off = 0;
+			return SBI_ENOMEM;
+		}
+
 		if (sbi_hart_has_extension(scratch, SBI_HART_EXT_TIME))
 			get_time_val = get_ticks;
 	} else {
-		if (!time_delta_off)
+		if (!time_delta_off || !timer_queue_off)
 			return SBI_ENOMEM;
 	}
 
 	time_delta = sbi_scratch_offset_ptr(scratch, time_delta_off);
 	*time_delta = 0;
 
-	return sbi_platform_timer_init(plat, cold_boot);
+	q = sbi_scratch_offset_ptr(scratch, timer_queue_off);
+	timer_queue_reset(q);
+	q->smode.handler = timer_smode_expired;
+
+	rc = sbi_platform_timer_init(plat, cold_boot);
+	if (rc)
+		return rc;
+
+	return timer_fast_init(scratch, cold_boot);
 }
 
 void sbi_timer_exit(struct sbi_scratch *scratch)
@@ -219,5 +598,9 @@ void sbi_timer_exit(struct sbi_scratch *scratch)
 	csr_clear(CSR_MIP, MIP_STIP);
 	csr_clear(CSR_MIE, MIP_MTIP);
 
+	if (timer_queue_off)
+		timer_queue_reset(sbi_scratch_offset_ptr(scratch,
+							 timer_queue_off));
+
 	sbi_platform_timer_exit(sbi_platform_ptr(scratch));
 }
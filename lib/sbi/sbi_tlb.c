@@ -11,9 +11,11 @@
 #include <sbi/riscv_asm.h>
 #include <sbi/riscv_atomic.h>
 #include <sbi/riscv_barrier.h>
+#include <sbi/riscv_locks.h>
 #include <sbi/sbi_error.h>
 #include <sbi/sbi_fifo.h>
 #include <sbi/sbi_hart.h>
+#include <sbi/sbi_illegal_insn.h>
 #include <sbi/sbi_ipi.h>
 #include <sbi/sbi_scratch.h>
 #include <sbi/sbi_tlb.h>
@@ -27,8 +29,29 @@
 static unsigned long tlb_sync_off;
 static unsigned long tlb_fifo_off;
 static unsigned long tlb_fifo_mem_off;
+static unsigned long tlb_overflow_off;
 static unsigned long tlb_range_flush_limit;
 
+/*
+ * Fence requests which did not fit into a full TLB FIFO. Instead of waiting
+ * for the target HART to make room, the source HART records the kind of fence
+ * here and the target HART performs a full flush of that kind.
+ */
+struct sbi_tlb_overflow {
+	spinlock_t lock;
+	/* Bitmap of pending fence classes */
+	unsigned long pending;
+	/*
+	 * Distinct VMIDs of the pending HFENCE.VVMA requests. A source HART
+	 * waits for each request to complete before sending another one,
+	 * so there is at most one VMID per source HART.
+	 */
+	u32 vvma_count;
+	u16 vvma_vmid[SBI_HARTMASK_MAX_BITS];
+	/* HARTs waiting for the pending requests to complete */
+	struct sbi_hartmask smask;
+};
+
 static void tlb_flush_all(void)
 {
 	__asm__ __volatile("sfence.vma");
@@ -250,15 +273,13 @@ static void tlb_pmu_incr_fw_ctr(struct sbi_tlb_info *data)
 		sbi_pmu_ctr_incr_fw(SBI_PMU_FW_HFENCE_VVMA_ASID_SENT);
 }
 
-static void tlb_entry_process(struct sbi_tlb_info *tinfo)
+static void tlb_entry_ack(struct sbi_hartmask *smask)
 {
 	u32 rhartid;
 	struct sbi_scratch *rscratch = NULL;
 	unsigned long *rtlb_sync = NULL;
 
-	tinfo->local_fn(tinfo);
-
-	sbi_hartmask_for_each_hart(rhartid, &tinfo->smask) {
+	sbi_hartmask_for_each_hart(rhartid, smask) {
 		rscratch = sbi_hartid_to_scratch(rhartid);
 		if (!rscratch)
 			continue;
@@ -268,6 +289,186 @@ static void tlb_entry_process(struct sbi_tlb_info *tinfo)
 	}
 }
 
+static void tlb_entry_process(struct sbi_tlb_info *tinfo)
+{
+	tinfo->local_fn(tinfo);
+	sbi_illegal_insn_cache_flush();
+
+	tlb_entry_ack(&tinfo->smask);
+}
+
+static inline bool tlb_range_is_all(struct sbi_tlb_info *tinfo)
+{
+	return (tinfo->start == 0 && tinfo->size == 0) ||
+	       (tinfo->size == SBI_TLB_FLUSH_ALL);
+}
+
+static inline bool tlb_range_covers(struct sbi_tlb_info *outer,
+				    struct sbi_tlb_info *inner)
+{
+	if (tlb_range_is_all(outer))
+		return true;
+	if (tlb_range_is_all(inner))
+		return false;
+
+	return inner->start >= outer->start &&
+	       inner->start + inner->size <= outer->start + outer->size;
+}
+
+/* Kind of TLB maintained by a fence request */
+enum tlb_fence_class {
+	TLB_FENCE_CLASS_NONE = 0,
+	TLB_FENCE_CLASS_FENCE_I,
+	TLB_FENCE_CLASS_SFENCE,
+	TLB_FENCE_CLASS_HFENCE_GVMA,
+	TLB_FENCE_CLASS_HFENCE_VVMA,
+};
+
+static enum tlb_fence_class tlb_fence_class(struct sbi_tlb_info *tinfo)
+{
+	if (tinfo->local_fn == sbi_tlb_local_fence_i)
+		return TLB_FENCE_CLASS_FENCE_I;
+	if (tinfo->local_fn == sbi_tlb_local_sfence_vma ||
+	    tinfo->local_fn == sbi_tlb_local_sfence_vma_asid)
+		return TLB_FENCE_CLASS_SFENCE;
+	if (tinfo->local_fn == sbi_tlb_local_hfence_gvma ||
+	    tinfo->local_fn == sbi_tlb_local_hfence_gvma_vmid)
+		return TLB_FENCE_CLASS_HFENCE_GVMA;
+	if (tinfo->local_fn == sbi_tlb_local_hfence_vvma ||
+	    tinfo->local_fn == sbi_tlb_local_hfence_vvma_asid)
+		return TLB_FENCE_CLASS_HFENCE_VVMA;
+
+	return TLB_FENCE_CLASS_NONE;
+}
+
+/*
+ * A request tagged with an ASID (or VMID for HFENCE.GVMA) whose start and
+ * size are both zero flushes all address spaces, exactly like the untagged
+ * variant. Such requests and the untagged variants match any tag.
+ */
+static inline bool tlb_tag_is_any(struct sbi_tlb_info *tinfo)
+{
+	if (tinfo->local_fn == sbi_tlb_local_sfence_vma ||
+	    tinfo->local_fn == sbi_tlb_local_hfence_gvma ||
+	    tinfo->local_fn == sbi_tlb_local_hfence_vvma)
+		return true;
+
+	return tinfo->start == 0 && tinfo->size == 0;
+}
+
+static inline unsigned long tlb_tag(struct sbi_tlb_info *tinfo)
+{
+	if (tinfo->local_fn == sbi_tlb_local_hfence_gvma_vmid)
+		return tinfo->vmid;
+
+	return tinfo->asid;
+}
+
+/* Check whether executing fence @outer makes fence @inner redundant */
+static bool tlb_fence_covers(struct sbi_tlb_info *outer,
+			     struct sbi_tlb_info *inner)
+{
+	enum tlb_fence_class class = tlb_fence_class(outer);
+
+	if (class == TLB_FENCE_CLASS_NONE || class != tlb_fence_class(inner))
+		return false;
+
+	if (class == TLB_FENCE_CLASS_FENCE_I)
+		return true;
+
+	/*
+	 * Without a native H extension every HFENCE variant simply drops
+	 * all shadow page tables of the receiving hart.
+	 */
+	if (class != TLB_FENCE_CLASS_SFENCE && !misa_extension('H'))
+		return true;
+
+	/* HFENCE.VVMA always operates on the VMID of the requester */
+	if (class == TLB_FENCE_CLASS_HFENCE_VVMA && outer->vmid != inner->vmid)
+		return false;
+
+	if (!tlb_tag_is_any(outer) &&
+	    (tlb_tag_is_any(inner) || tlb_tag(outer) != tlb_tag(inner)))
+		return false;
+
+	return tlb_range_covers(outer, inner);
+}
+
+static void tlb_overflow_update(struct sbi_scratch *remote_scratch,
+				struct sbi_tlb_info *tinfo)
+{
+	enum tlb_fence_class class = tlb_fence_class(tinfo);
+	struct sbi_tlb_overflow *ovf =
+			sbi_scratch_offset_ptr(remote_scratch, tlb_overflow_off);
+	u32 i;
+
+	spin_lock(&ovf->lock);
+
+	/* HFENCE.VVMA only flushes the VMID it is issued for */
+	if (class == TLB_FENCE_CLASS_HFENCE_VVMA && misa_extension('H')) {
+		for (i = 0; i < ovf->vvma_count; i++) {
+			if (ovf->vvma_vmid[i] == tinfo->vmid)
+				break;
+		}
+		if (i == ovf->vvma_count)
+			ovf->vvma_vmid[ovf->vvma_count++] = tinfo->vmid;
+	}
+
+	ovf->pending |= BIT(class);
+	sbi_hartmask_or(&ovf->smask, &ovf->smask, &tinfo->smask);
+
+	spin_unlock(&ovf->lock);
+}
+
+static void tlb_overflow_process(struct sbi_scratch *scratch)
+{
+	unsigned long pending;
+	struct sbi_tlb_info tinfo;
+	u16 vvma_vmid[SBI_HARTMASK_MAX_BITS];
+	u32 i, vvma_count;
+	struct sbi_tlb_overflow *ovf =
+			sbi_scratch_offset_ptr(scratch, tlb_overflow_off);
+
+	if (!ovf->pending)
+		return;
+
+	tinfo.start = 0;
+	tinfo.size = SBI_TLB_FLUSH_ALL;
+	tinfo.asid = 0;
+	tinfo.vmid = 0;
+	tinfo.local_fn = NULL;
+
+	spin_lock(&ovf->lock);
+	pending = ovf->pending;
+	vvma_count = ovf->vvma_count;
+	for (i = 0; i < vvma_count; i++)
+		vvma_vmid[i] = ovf->vvma_vmid[i];
+	tinfo.smask = ovf->smask;
+	ovf->pending = 0;
+	ovf->vvma_count = 0;
+	SBI_HARTMASK_INIT(&ovf->smask);
+	spin_unlock(&ovf->lock);
+
+	if (pending & BIT(TLB_FENCE_CLASS_FENCE_I))
+		sbi_tlb_local_fence_i(&tinfo);
+	if (pending & BIT(TLB_FENCE_CLASS_SFENCE))
+		sbi_tlb_local_sfence_vma(&tinfo);
+	if (pending & BIT(TLB_FENCE_CLASS_HFENCE_GVMA))
+		sbi_tlb_local_hfence_gvma(&tinfo);
+	if (pending & BIT(TLB_FENCE_CLASS_HFENCE_VVMA)) {
+		/* Without native H extension no VMIDs are recorded */
+		if (!vvma_count)
+			sbi_tlb_local_hfence_vvma(&tinfo);
+		for (i = 0; i < vvma_count; i++) {
+			tinfo.vmid = vvma_vmid[i];
+			sbi_tlb_local_hfence_vvma(&tinfo);
+		}
+	}
+	sbi_illegal_insn_cache_flush();
+
+	tlb_entry_ack(&tinfo.smask);
+}
+
 static void tlb_process_count(struct sbi_scratch *scratch, int count)
 {
 	struct sbi_tlb_info tinfo;
@@ -282,6 +483,8 @@ static void tlb_process_count(struct sbi_scratch *scratch, int count)
 			break;
 
 	}
+
+	tlb_overflow_process(scratch);
 }
 
 static void tlb_process(struct sbi_scratch *scratch)
@@ -292,6 +495,8 @@ static void tlb_process(struct sbi_scratch *scratch)
 
 	while (!sbi_fifo_dequeue(tlb_fifo, &tinfo))
 		tlb_entry_process(&tinfo);
+
+	tlb_overflow_process(scratch);
 }
 
 static void tlb_sync(struct sbi_scratch *scratch)
@@ -302,50 +507,34 @@ static void tlb_sync(struct sbi_scratch *scratch)
 	while (!atomic_raw_xchg_ulong(tlb_sync, 0)) {
 		/*
 		 * While we are waiting for remote hart to set the sync,
-		 * consume fifo requests to avoid deadlock.
+		 * consume fifo and overflow requests and pass on the IPIs
+		 * other HARTs left with us as cluster leader to avoid
+		 * deadlock.
 		 */
 		tlb_process_count(scratch, 1);
+		sbi_ipi_process_forward();
 	}
 
 	return;
 }
 
-static inline int tlb_range_check(struct sbi_tlb_info *curr,
-					struct sbi_tlb_info *next)
-{
-	unsigned long curr_end;
-	unsigned long next_end;
-	int ret = SBI_FIFO_UNCHANGED;
-
-	if (!curr || !next)
-		return ret;
-
-	next_end = next->start + next->size;
-	curr_end = curr->start + curr->size;
-	if (next->start <= curr->start && next_end > curr_end) {
-		curr->start = next->start;
-		curr->size  = next->size;
-		sbi_hartmask_or(&curr->smask, &curr->smask, &next->smask);
-		ret = SBI_FIFO_UPDATED;
-	} else if (next->start >= curr->start && next_end <= curr_end) {
-		sbi_hartmask_or(&curr->smask, &curr->smask, &next->smask);
-		ret = SBI_FIFO_SKIP;
-	}
-
-	return ret;
-}
-
 /**
  * Call back to decide if an inplace fifo update is required or next entry can
  * can be skipped. Here are the different cases that are being handled.
  *
  * Case1:
- *	if next flush request range lies within one of the existing entry, skip
+ *	if next flush request is covered by one of the existing entries, skip
  *	the next entry.
  * Case2:
- *	if flush request range in current fifo entry lies within next flush
+ *	if flush request in current fifo entry is covered by next flush
  *	request, update the current entry.
  *
+ * A request covers another one if both maintain the same kind of TLB
+ * (SFENCE.VMA, HFENCE.GVMA or HFENCE.VVMA), the VMID/ASID scope of the
+ * first includes the scope of the second and so does its address range.
+ * In particular, a full flush entry absorbs every later request of its kind.
+ * Any FENCE.I request covers any other FENCE.I request.
+ *
  * Note:
  *	We can not issue a fifo reset anymore if a complete vma flush is requested.
  *	This is because we are queueing FENCE.I requests as well now.
@@ -357,24 +546,29 @@ static int tlb_update_cb(void *in, void *data)
 {
 	struct sbi_tlb_info *curr;
 	struct sbi_tlb_info *next;
-	int ret = SBI_FIFO_UNCHANGED;
 
 	if (!in || !data)
-		return ret;
+		return SBI_FIFO_UNCHANGED;
 
 	curr = (struct sbi_tlb_info *)data;
 	next = (struct sbi_tlb_info *)in;
 
-	if (next->local_fn == sbi_tlb_local_sfence_vma_asid &&
-	    curr->local_fn == sbi_tlb_local_sfence_vma_asid) {
-		if (next->asid == curr->asid)
-			ret = tlb_range_check(curr, next);
-	} else if (next->local_fn == sbi_tlb_local_sfence_vma &&
-		   curr->local_fn == sbi_tlb_local_sfence_vma) {
-		ret = tlb_range_check(curr, next);
+	if (tlb_fence_covers(curr, next)) {
+		sbi_hartmask_or(&curr->smask, &curr->smask, &next->smask);
+		return SBI_FIFO_SKIP;
+	}
+
+	if (tlb_fence_covers(next, curr)) {
+		curr->start = next->start;
+		curr->size = next->size;
+		curr->asid = next->asid;
+		curr->vmid = next->vmid;
+		curr->local_fn = next->local_fn;
+		sbi_hartmask_or(&curr->smask, &curr->smask, &next->smask);
+		return SBI_FIFO_UPDATED;
 	}
 
-	return ret;
+	return SBI_FIFO_UNCHANGED;
 }
 
 static int tlb_update(struct sbi_scratch *scratch,
@@ -402,6 +596,7 @@ static int tlb_update(struct sbi_scratch *scratch,
 	 */
 	if (remote_hartid == curr_hartid) {
 		tinfo->local_fn(tinfo);
+		sbi_illegal_insn_cache_flush();
 		return -1;
 	}
 
@@ -412,19 +607,14 @@ static int tlb_update(struct sbi_scratch *scratch,
 		return 1;
 	}
 
-	while (sbi_fifo_enqueue(tlb_fifo_r, data) < 0) {
-		/**
-		 * For now, Busy loop until there is space in the fifo.
-		 * There may be case where target hart is also
-		 * enqueue in source hart's fifo. Both hart may busy
-		 * loop leading to a deadlock.
-		 * TODO: Introduce a wait/wakeup event mechanism to handle
-		 * this properly.
-		 */
-		tlb_process_count(scratch, 1);
-		sbi_dprintf("hart%d: hart%d tlb fifo full\n",
-			    curr_hartid, remote_hartid);
-	}
+	/**
+	 * Never wait for the target hart to make room in its fifo since
+	 * it may be enqueueing into our fifo at the same time. Instead,
+	 * ask it to do a full flush of the requested kind once it
+	 * processes its pending requests.
+	 */
+	if (sbi_fifo_enqueue(tlb_fifo_r, data) < 0)
+		tlb_overflow_update(remote_scratch, tinfo);
 
 	return 0;
 }
@@ -440,7 +630,9 @@ static u32 tlb_event = SBI_IPI_EVENT_MAX;
 
 int sbi_tlb_request(ulong hmask, ulong hbase, struct sbi_tlb_info *tinfo)
 {
-	if (!tinfo->local_fn)
+	/* Only known fences can be folded into the overflow record */
+	if (!tinfo->local_fn ||
+	    tlb_fence_class(tinfo) == TLB_FENCE_CLASS_NONE)
 		return SBI_EINVAL;
 
 	tlb_pmu_incr_fw_ctr(tinfo);
@@ -454,26 +646,45 @@ int sbi_tlb_init(struct sbi_scratch *scratch, bool cold_boot)
 	void *tlb_mem;
 	unsigned long *tlb_sync;
 	struct sbi_fifo *tlb_q;
+	struct sbi_tlb_overflow *tlb_ovf;
 	const struct sbi_platform *plat = sbi_platform_ptr(scratch);
 
 	if (cold_boot) {
-		tlb_sync_off = sbi_scratch_alloc_offset(sizeof(*tlb_sync));
+		/*
+		 * Everything here is written by remote HARTs, so keep the
+		 * sync word, the queue and the overflow record on cache
+		 * lines of their own. The FIFO entries directly follow
+		 * the FIFO header.
+		 */
+		tlb_sync_off = sbi_scratch_alloc_aligned_offset("tlb_sync",
+					sizeof(*tlb_sync), SBI_CACHE_LINE_SIZE);
 		if (!tlb_sync_off)
 			return SBI_ENOMEM;
-		tlb_fifo_off = sbi_scratch_alloc_offset(sizeof(*tlb_q));
+		tlb_fifo_off = sbi_scratch_alloc_aligned_offset("tlb_fifo",
+					sizeof(*tlb_q), SBI_CACHE_LINE_SIZE);
 		if (!tlb_fifo_off) {
 			sbi_scratch_free_offset(tlb_sync_off);
 			return SBI_ENOMEM;
 		}
-		tlb_fifo_mem_off = sbi_scratch_alloc_offset(
-				SBI_TLB_FIFO_NUM_ENTRIES * SBI_TLB_INFO_SIZE);
+		tlb_fifo_mem_off = sbi_scratch_alloc_aligned_offset("tlb_fifo_mem",
+				SBI_TLB_FIFO_NUM_ENTRIES * SBI_TLB_INFO_SIZE,
+				__SIZEOF_POINTER__);
 		if (!tlb_fifo_mem_off) {
 			sbi_scratch_free_offset(tlb_fifo_off);
 			sbi_scratch_free_offset(tlb_sync_off);
 			return SBI_ENOMEM;
 		}
+		tlb_overflow_off = sbi_scratch_alloc_aligned_offset("tlb_overflow",
+					sizeof(*tlb_ovf), SBI_CACHE_LINE_SIZE);
+		if (!tlb_overflow_off) {
+			sbi_scratch_free_offset(tlb_fifo_mem_off);
+			sbi_scratch_free_offset(tlb_fifo_off);
+			sbi_scratch_free_offset(tlb_sync_off);
+			return SBI_ENOMEM;
+		}
 		ret = sbi_ipi_event_create(&tlb_ops);
 		if (ret < 0) {
+			sbi_scratch_free_offset(tlb_overflow_off);
 			sbi_scratch_free_offset(tlb_fifo_mem_off);
 			sbi_scratch_free_offset(tlb_fifo_off);
 			sbi_scratch_free_offset(tlb_sync_off);
@@ -484,7 +695,8 @@ int sbi_tlb_init(struct sbi_scratch *scratch, bool cold_boot)
 	} else {
 		if (!tlb_sync_off ||
 		    !tlb_fifo_off ||
-		    !tlb_fifo_mem_off)
+		    !tlb_fifo_mem_off ||
+		    !tlb_overflow_off)
 			return SBI_ENOMEM;
 		if (SBI_IPI_EVENT_MAX <= tlb_event)
 			return SBI_ENOSPC;
@@ -493,9 +705,15 @@ int sbi_tlb_init(struct sbi_scratch *scratch, bool cold_boot)
 	tlb_sync = sbi_scratch_offset_ptr(scratch, tlb_sync_off);
 	tlb_q = sbi_scratch_offset_ptr(scratch, tlb_fifo_off);
 	tlb_mem = sbi_scratch_offset_ptr(scratch, tlb_fifo_mem_off);
+	tlb_ovf = sbi_scratch_offset_ptr(scratch, tlb_overflow_off);
 
 	*tlb_sync = 0;
 
+	SPIN_LOCK_INIT(tlb_ovf->lock);
+	tlb_ovf->pending = 0;
+	tlb_ovf->vvma_count = 0;
+	SBI_HARTMASK_INIT(&tlb_ovf->smask);
+
 	sbi_fifo_init(tlb_q, tlb_mem,
 		      SBI_TLB_FIFO_NUM_ENTRIES, SBI_TLB_INFO_SIZE);
 
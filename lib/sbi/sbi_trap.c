@@ -366,10 +366,10 @@ struct sbi_trap_regs *sbi_trap_handler(struct sbi_trap_regs *regs)
 
 	switch (mcause) {
 	case CAUSE_ILLEGAL_INSTRUCTION:
-		/* rc  = sbi_illegal_insn_handler(mtval, regs); */
 		/* QEMU 7.0.0 would sometimes give an incorrect mtval for
-		 * illegal instructions. Ignore it. */
-		rc  = sbi_illegal_insn_handler(0ul, regs);
+		 * illegal instructions. The handler only uses it to look
+		 * up an instruction it fetched before. */
+		rc  = sbi_illegal_insn_handler(mtval, regs);
 		msg = "illegal instruction handler failed";
 		break;
 	case CAUSE_MISALIGNED_LOAD:
@@ -418,6 +418,9 @@ struct sbi_trap_regs *sbi_trap_handler(struct sbi_trap_regs *regs)
 trap_error:
 	if (rc)
 		sbi_trap_error(msg, rc, mcause, mtval, mtval2, mtinst, regs);
+
+	sbi_console_drain();
+
 	return regs;
 }
 
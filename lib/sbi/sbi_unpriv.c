@@ -7,6 +7,7 @@
  *   Anup Patel <anup.patel@wdc.com>
  */
 
+#include <sbi/riscv_asm.h>
 #include <sbi/riscv_encoding.h>
 #include <sbi/sbi_bitops.h>
 #include <sbi/sbi_hart.h>
@@ -116,6 +117,123 @@ void sbi_store_u64(u64 *addr, u64 val,
 # error "Unexpected __riscv_xlen"
 #endif
 
+ulong sbi_load_unaligned(ulong addr, ulong len, struct sbi_trap_info *trap)
+{
+	register ulong tinfo asm("a3");
+	register ulong tfault asm("a4") = 0;
+	register ulong mstatus = 0;
+	register ulong mtvec = sbi_hart_expected_trap_addr();
+	ulong base = addr & ~(ulong)(sizeof(ulong) - 1);
+	ulong off = addr & (sizeof(ulong) - 1);
+	ulong cross = (off + len) > sizeof(ulong);
+	ulong lo = 0, hi = 0, ret;
+
+	trap->cause = 0;
+
+	/*
+	 * Read the one or two naturally aligned words covering the access
+	 * in a single MPRV window. The expected trap handler leaves a
+	 * non-zero value in a4 so we can leave the window on a fault.
+	 */
+	asm volatile(
+	    "add %[tinfo], %[taddr], zero\n"
+	    "csrrw %[mtvec], " STR(CSR_MTVEC) ", %[mtvec]\n"
+	    "csrrs %[mstatus], " STR(CSR_MSTATUS) ", %[mprv]\n"
+	    ".option push\n"
+	    ".option norvc\n"
+	    REG_L " %[lo], 0(%[base])\n"
+	    "bnez %[tfault], 1f\n"
+	    "beqz %[cross], 1f\n"
+	    REG_L " %[hi], " SZREG "(%[base])\n"
+	    ".option pop\n"
+	    "1: csrw " STR(CSR_MSTATUS) ", %[mstatus]\n"
+	    "csrw " STR(CSR_MTVEC) ", %[mtvec]"
+	    : [mstatus] "+&r"(mstatus), [mtvec] "+&r"(mtvec),
+	      [tinfo] "+&r"(tinfo), [tfault] "+&r"(tfault),
+	      [lo] "+&r"(lo), [hi] "+&r"(hi)
+	    : [mprv] "r"(MSTATUS_MPRV), [taddr] "r"((ulong)trap),
+	      [base] "r"(base), [cross] "r"(cross)
+	    : "memory");
+
+	if (trap->cause)
+		return 0;
+
+	ret = lo >> (off * 8);
+	if (cross)
+		ret |= hi << ((sizeof(ulong) - off) * 8);
+	if (len < sizeof(ulong))
+		ret &= (1UL << (len * 8)) - 1;
+
+	return ret;
+}
+
+void sbi_store_unaligned(ulong addr, ulong val, ulong len,
+			 struct sbi_trap_info *trap)
+{
+	register ulong tinfo asm("a3");
+	register ulong tfault asm("a4") = 0;
+	register ulong mstatus = 0;
+	register ulong mtvec = sbi_hart_expected_trap_addr();
+	ulong tmp;
+
+	trap->cause = 0;
+
+	/*
+	 * Write the value as a sequence of the largest naturally aligned
+	 * chunks in a single MPRV window. Bytes outside the access are
+	 * never written so concurrent stores to them are not lost. Stop
+	 * at the first fault since the expected trap handler changes
+	 * MPP, and with it the privilege of any further access.
+	 */
+	asm volatile(
+	    "add %[tinfo], %[taddr], zero\n"
+	    "csrrw %[mtvec], " STR(CSR_MTVEC) ", %[mtvec]\n"
+	    "csrrs %[mstatus], " STR(CSR_MSTATUS) ", %[mprv]\n"
+	    ".option push\n"
+	    ".option norvc\n"
+	    "1: beqz %[len], 7f\n"
+	    "andi %[tmp], %[addr], 1\n"
+	    "bnez %[tmp], 2f\n"
+	    "sltiu %[tmp], %[len], 2\n"
+	    "bnez %[tmp], 2f\n"
+	    "andi %[tmp], %[addr], 2\n"
+	    "bnez %[tmp], 3f\n"
+	    "sltiu %[tmp], %[len], 4\n"
+	    "bnez %[tmp], 3f\n"
+#if __riscv_xlen == 64
+	    "andi %[tmp], %[addr], 4\n"
+	    "bnez %[tmp], 4f\n"
+	    "sltiu %[tmp], %[len], 8\n"
+	    "bnez %[tmp], 4f\n"
+	    "sd %[val], 0(%[addr])\n"
+	    "li %[tmp], 8\n"
+	    "j 6f\n"
+#endif
+	    "4: sw %[val], 0(%[addr])\n"
+	    "li %[tmp], 4\n"
+	    "j 6f\n"
+	    "3: sh %[val], 0(%[addr])\n"
+	    "li %[tmp], 2\n"
+	    "j 6f\n"
+	    "2: sb %[val], 0(%[addr])\n"
+	    "li %[tmp], 1\n"
+	    "6: bnez %[tfault], 7f\n"
+	    "add %[addr], %[addr], %[tmp]\n"
+	    "sub %[len], %[len], %[tmp]\n"
+	    "slli %[tmp], %[tmp], 3\n"
+	    "srl %[val], %[val], %[tmp]\n"
+	    "j 1b\n"
+	    ".option pop\n"
+	    "7: csrw " STR(CSR_MSTATUS) ", %[mstatus]\n"
+	    "csrw " STR(CSR_MTVEC) ", %[mtvec]"
+	    : [mstatus] "+&r"(mstatus), [mtvec] "+&r"(mtvec),
+	      [tinfo] "+&r"(tinfo), [tfault] "+&r"(tfault),
+	      [addr] "+&r"(addr), [val] "+&r"(val), [len] "+&r"(len),
+	      [tmp] "=&r"(tmp)
+	    : [mprv] "r"(MSTATUS_MPRV), [taddr] "r"((ulong)trap)
+	    : "memory");
+}
+
 ulong sbi_get_insn(ulong mepc, struct sbi_trap_info *trap)
 {
 	register ulong tinfo asm("a3");
@@ -35,6 +35,25 @@ static void mswi_ipi_send(u32 target_hart)
 	writel(1, &msip[target_hart - mswi->first_hartid]);
 }
 
+static void mswi_ipi_send_mask(const struct sbi_hartmask *target_mask)
+{
+	u32 *msip, target_hart;
+	struct aclint_mswi_data *mswi;
+
+	/* Order all prior writes once, then post the MSIP writes back-to-back */
+	wmb();
+
+	sbi_hartmask_for_each_hart(target_hart, target_mask) {
+		mswi = mswi_hartid2data[target_hart];
+		if (!mswi)
+			continue;
+
+		/* Set ACLINT IPI */
+		msip = (void *)mswi->addr;
+		writel_relaxed(1, &msip[target_hart - mswi->first_hartid]);
+	}
+}
+
 static void mswi_ipi_clear(u32 target_hart)
 {
 	u32 *msip;
@@ -54,6 +73,7 @@ static void mswi_ipi_clear(u32 target_hart)
 static struct sbi_ipi_device aclint_mswi = {
 	.name = "aclint-mswi",
 	.ipi_send = mswi_ipi_send,
+	.ipi_send_mask = mswi_ipi_send_mask,
 	.ipi_clear = mswi_ipi_clear
 };
 
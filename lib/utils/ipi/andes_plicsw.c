@@ -40,7 +40,7 @@ static inline void plicsw_complete(void)
 			       PLICSW_CONTEXT_STRIDE * hartid);
 }
 
-static inline void plic_sw_pending(u32 target_hart)
+static inline void plic_sw_pending(u32 target_mask)
 {
 	/*
 	 * The pending array registers are w1s type.
@@ -58,12 +58,13 @@ static inline void plic_sw_pending(u32 target_hart)
 	 * | bit7 | ... | bit3 | bit2 | bit1 | bit0 |
 	 * ------------------------------------------
 	 * The bitY of hartX region indicates that hartX sends an
-	 * IPI to hartY.
+	 * IPI to hartY. Hence, all the targets of hartX can be set
+	 * with a single write.
 	 */
 	u32 hartid	    = current_hartid();
 	u32 word_index	    = hartid / 4;
 	u32 per_hart_offset = PLICSW_PENDING_STRIDE * hartid;
-	u32 val		    = 1 << target_hart << per_hart_offset;
+	u32 val		    = target_mask << per_hart_offset;
 
 	writel(val, (void *)plicsw.addr + PLICSW_PENDING_BASE + word_index * 4);
 }
@@ -74,7 +75,22 @@ static void plicsw_ipi_send(u32 target_hart)
 		ebreak();
 
 	/* Set PLICSW IPI */
-	plic_sw_pending(target_hart);
+	plic_sw_pending(1U << target_hart);
+}
+
+static void plicsw_ipi_send_mask(const struct sbi_hartmask *target_mask)
+{
+	u32 target_hart, pending = 0;
+
+	sbi_hartmask_for_each_hart(target_hart, target_mask) {
+		if (plicsw.hart_count <= target_hart)
+			ebreak();
+		pending |= 1U << target_hart;
+	}
+
+	/* Set PLICSW IPI for all targets at once */
+	if (pending)
+		plic_sw_pending(pending);
 }
 
 static void plicsw_ipi_clear(u32 target_hart)
@@ -90,6 +106,7 @@ static void plicsw_ipi_clear(u32 target_hart)
 static struct sbi_ipi_device plicsw_ipi = {
 	.name      = "andes_plicsw",
 	.ipi_send  = plicsw_ipi_send,
+	.ipi_send_mask = plicsw_ipi_send_mask,
 	.ipi_clear = plicsw_ipi_clear
 };
 
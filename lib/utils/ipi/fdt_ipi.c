@@ -7,7 +7,9 @@
  *   Anup Patel <anup.patel@wdc.com>
  */
 
+#include <libfdt.h>
 #include <sbi/sbi_error.h>
+#include <sbi/sbi_ipi.h>
 #include <sbi/sbi_scratch.h>
 #include <sbi_utils/fdt/fdt_helper.h>
 #include <sbi_utils/ipi/fdt_ipi.h>
@@ -38,6 +40,71 @@ static int fdt_ipi_warm_init(void)
 	return 0;
 }
 
+#ifdef CONFIG_FDT_IPI_CLUSTER
+
+static int fdt_ipi_cluster_parse(void *fdt, int nodeoff, u32 cluster,
+				 u32 *cluster_count)
+{
+	int rc, child, cpu_offset, len;
+	const fdt32_t *val;
+	const char *name;
+	u32 hartid, child_cluster;
+
+	fdt_for_each_subnode(child, fdt, nodeoff) {
+		val = fdt_getprop(fdt, child, "cpu", &len);
+		if (val && len >= sizeof(fdt32_t)) {
+			cpu_offset = fdt_node_offset_by_phandle(fdt,
+							fdt32_to_cpu(*val));
+			if (cpu_offset < 0)
+				continue;
+
+			if (fdt_parse_hart_id(fdt, cpu_offset, &hartid))
+				continue;
+
+			sbi_ipi_set_hart_cluster(hartid, cluster);
+			continue;
+		}
+
+		/* The innermost socket or cluster node groups the HARTs */
+		child_cluster = cluster;
+		name = fdt_get_name(fdt, child, NULL);
+		if (name && (!strncmp(name, "cluster", strlen("cluster")) ||
+			     !strncmp(name, "socket", strlen("socket")))) {
+			/* HARTs of further clusters get direct IPIs */
+			if (*cluster_count < SBI_IPI_CLUSTER_MAX)
+				child_cluster = (*cluster_count)++;
+			else
+				child_cluster = SBI_IPI_CLUSTER_NONE;
+		}
+
+		rc = fdt_ipi_cluster_parse(fdt, child, child_cluster,
+					   cluster_count);
+		if (rc)
+			return rc;
+	}
+
+	return 0;
+}
+
+static int fdt_ipi_cluster_init(void *fdt)
+{
+	u32 cluster_count = 0;
+	int cpu_map = fdt_path_offset(fdt, "/cpus/cpu-map");
+
+	/* Without a cpu-map, all IPIs are delivered directly */
+	if (cpu_map < 0)
+		return 0;
+
+	return fdt_ipi_cluster_parse(fdt, cpu_map, SBI_IPI_CLUSTER_NONE,
+				     &cluster_count);
+}
+
+#else
+
+static int fdt_ipi_cluster_init(void *fdt) { return 0; }
+
+#endif
+
 static int fdt_ipi_cold_init(void)
 {
 	int pos, noff, rc;
@@ -65,7 +132,7 @@ static int fdt_ipi_cold_init(void)
 			break;
 	}
 
-	return 0;
+	return fdt_ipi_cluster_init(fdt);
 }
 
 int fdt_ipi_init(bool cold_boot)
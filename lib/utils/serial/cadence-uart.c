@@ -32,8 +32,12 @@
 #define UART_BRGR_CD_CLKDIVISOR	0x00000001	/* baud_sample = sel_clk */
 
 #define	UART_CSR_REMPTY		0x00000002
+#define	UART_CSR_TEMPTY		0x00000008
 #define	UART_CSR_TFUL		0x00000010
 
+/* Conservative transmit FIFO depth, the IP is often configured deeper */
+#define UART_TXFIFO_SIZE	16
+
 /* clang-format on */
 
 static volatile void *uart_base;
@@ -74,6 +78,21 @@ static void cadence_uart_putc(char ch)
 	set_reg(UART_REG_RFIFO_TFIFO, ch);
 }
 
+static int cadence_uart_puts(const char *str, int len)
+{
+	int i;
+
+	while (!(get_reg(UART_REG_CSR) & UART_CSR_TEMPTY))
+		;
+
+	if (len > UART_TXFIFO_SIZE)
+		len = UART_TXFIFO_SIZE;
+	for (i = 0; i < len; i++)
+		set_reg(UART_REG_RFIFO_TFIFO, str[i]);
+
+	return len;
+}
+
 static int cadence_uart_getc(void)
 {
 	u32 ret = get_reg(UART_REG_CSR);
@@ -87,6 +106,7 @@ static int cadence_uart_getc(void)
 static struct sbi_console_device cadence_console = {
 	.name = "cadence_uart",
 	.console_putc = cadence_uart_putc,
+	.console_puts = cadence_uart_puts,
 	.console_getc = cadence_uart_getc
 };
 
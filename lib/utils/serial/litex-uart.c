@@ -40,6 +40,22 @@ static void litex_uart_putc(char ch)
 	set_reg(UART_REG_RXTX, ch);
 }
 
+static int litex_uart_puts(const char *str, int len)
+{
+	int i = 0;
+
+	/*
+	 * Only a FIFO full flag is guaranteed to exist, so keep filling
+	 * the FIFO until it is full and return to the caller after that.
+	 */
+	while (get_reg(UART_REG_TXFULL));
+	do {
+		set_reg(UART_REG_RXTX, str[i++]);
+	} while (i < len && !get_reg(UART_REG_TXFULL));
+
+	return i;
+}
+
 static int litex_uart_getc(void)
 {
 	if (get_reg(UART_REG_RXEMPTY))
@@ -51,6 +67,7 @@ static int litex_uart_getc(void)
 static struct sbi_console_device litex_console = {
 	.name = "litex_uart",
 	.console_putc = litex_uart_putc,
+	.console_puts = litex_uart_puts,
 	.console_getc = litex_uart_getc
 };
 
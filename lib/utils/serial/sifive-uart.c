@@ -25,8 +25,12 @@
 #define UART_RXFIFO_EMPTY	0x80000000
 #define UART_RXFIFO_DATA	0x000000ff
 #define UART_TXCTRL_TXEN	0x1
+#define UART_TXCTRL_TXCNT_SHIFT	16
+#define UART_IP_TXWM		0x1
 #define UART_RXCTRL_RXEN	0x1
 
+#define UART_TXFIFO_SIZE	8
+
 /* clang-format on */
 
 static volatile char *uart_base;
@@ -74,6 +78,22 @@ static void sifive_uart_putc(char ch)
 	set_reg(UART_REG_TXFIFO, ch);
 }
 
+static int sifive_uart_puts(const char *str, int len)
+{
+	int i;
+
+	/* The watermark is one entry, so it is pending once TX is empty */
+	while (!(get_reg(UART_REG_IP) & UART_IP_TXWM))
+		;
+
+	if (len > UART_TXFIFO_SIZE)
+		len = UART_TXFIFO_SIZE;
+	for (i = 0; i < len; i++)
+		set_reg(UART_REG_TXFIFO, str[i]);
+
+	return len;
+}
+
 static int sifive_uart_getc(void)
 {
 	u32 ret = get_reg(UART_REG_RXFIFO);
@@ -87,6 +107,7 @@ static int sifive_uart_getc(void)
 static struct sbi_console_device sifive_console = {
 	.name = "sifive_uart",
 	.console_putc = sifive_uart_putc,
+	.console_puts = sifive_uart_puts,
 	.console_getc = sifive_uart_getc
 };
 
@@ -103,8 +124,9 @@ int sifive_uart_init(unsigned long base, u32 in_freq, u32 baudrate)
 	/* Disable interrupts */
 	set_reg(UART_REG_IE, 0);
 
-	/* Enable TX */
-	set_reg(UART_REG_TXCTRL, UART_TXCTRL_TXEN);
+	/* Enable TX, with a watermark of one entry for sifive_uart_puts() */
+	set_reg(UART_REG_TXCTRL,
+		UART_TXCTRL_TXEN | (1 << UART_TXCTRL_TXCNT_SHIFT));
 
 	/* Enable Rx */
 	set_reg(UART_REG_RXCTRL, UART_RXCTRL_RXEN);
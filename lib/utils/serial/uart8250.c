@@ -37,6 +37,10 @@
 #define UART_LSR_DR		0x01	/* Receiver data ready */
 #define UART_LSR_BRK_ERROR_BITS	0x1E	/* BI, FE, PE, OE bits */
 
+#define UART_IIR_FIFO_MASK	0xC0	/* FIFOs enabled (16550A and later) */
+
+#define UART_FIFO_SIZE		16	/* 16550A transmit FIFO depth */
+
 /* clang-format on */
 
 static volatile char *uart8250_base;
@@ -44,6 +48,7 @@ static u32 uart8250_in_freq;
 static u32 uart8250_baudrate;
 static u32 uart8250_reg_width;
 static u32 uart8250_reg_shift;
+static u32 uart8250_tx_burst;
 
 static u32 get_reg(u32 num)
 {
@@ -77,6 +82,22 @@ static void uart8250_putc(char ch)
 	set_reg(UART_THR_OFFSET, ch);
 }
 
+static int uart8250_puts(const char *str, int len)
+{
+	int i;
+
+	/* THRE is set once the whole transmit FIFO has drained */
+	while ((get_reg(UART_LSR_OFFSET) & UART_LSR_THRE) == 0)
+		;
+
+	if (len > uart8250_tx_burst)
+		len = uart8250_tx_burst;
+	for (i = 0; i < len; i++)
+		set_reg(UART_THR_OFFSET, str[i]);
+
+	return len;
+}
+
 static int uart8250_getc(void)
 {
 	if (get_reg(UART_LSR_OFFSET) & UART_LSR_DR)
@@ -87,6 +108,7 @@ static int uart8250_getc(void)
 static struct sbi_console_device uart8250_console = {
 	.name = "uart8250",
 	.console_putc = uart8250_putc,
+	.console_puts = uart8250_puts,
 	.console_getc = uart8250_getc
 };
 
@@ -122,6 +144,12 @@ int uart8250_init(unsigned long base, u32 in_freq, u32 baudrate, u32 reg_shift,
 	set_reg(UART_LCR_OFFSET, 0x03);
 	/* Enable FIFO */
 	set_reg(UART_FCR_OFFSET, 0x01);
+	/* Only a 16550A or later has a transmit FIFO to fill in bursts */
+	if ((get_reg(UART_IIR_OFFSET) & UART_IIR_FIFO_MASK) ==
+	    UART_IIR_FIFO_MASK)
+		uart8250_tx_burst = UART_FIFO_SIZE;
+	else
+		uart8250_tx_burst = 1;
 	/* No modem control DTR RTS */
 	set_reg(UART_MCR_OFFSET, 0x00);
 	/* Clear line status */